@@ -0,0 +1,377 @@
+#pragma once
+#ifndef __SERDES_ASYNC_HPP__
+#define __SERDES_ASYNC_HPP__
+
+#include "serializer_deserializer.hpp"
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SERDES_ASYNC_COROUTINE
+#endif
+#endif
+
+//--------------------------------------------------------------------------------------------------
+// Asynchronous encode-and-send pipeline (POSIX)
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+
+	inline bool set_nonblocking(int fd) {
+		const int flags = ::fcntl(fd, F_GETFL, 0);
+		return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+	}
+
+	inline bool is_socket(int fd) {
+		struct stat st;
+		return ::fstat(fd, &st) == 0 && S_ISSOCK(st.st_mode);
+	}
+
+} // namespace serdes
+
+// Encodes one uncompressed command frame in slices of about 'budget' bytes.
+// Containers at the top level of the arguments are split between elements,
+// any other argument is encoded in one step. The frame is the same as build_command.
+// The payload size of the header is summed first, in slices of about 'budget' bytes too,
+// so a large container of variable size elements is also measured over several calls.
+template<uint16_t class_id, uint16_t func_id, typename Tup, typename buf_t = uint8_t, bool big_endian = false>
+class SlicedCommandEncoder {
+	typedef SerDes<buf_t, big_endian> serdes_type;
+	static constexpr size_t arg_nums = std::tuple_size<Tup>::value;
+public:
+	explicit SlicedCommandEncoder(Tup&& tup) : args(std::move(tup)) {}
+
+	// Appends the next slice to 'out', returns true once the whole frame is written.
+	// A slice that only measures the payload appends nothing.
+	inline bool operator()(std::vector<buf_t>& out, size_t budget) {
+		const size_t limit = out.size() + budget;
+		if (!header_done) {
+			size_t measured = 0;
+			while (arg_idx < arg_nums && measured < budget)
+				size_arg<0>(measured, budget);
+			if (arg_idx < arg_nums)
+				return false;
+			const size_t pos = out.size();
+			out.resize(pos + DynamicSerDes<buf_t, big_endian>::command_header_size(payload_size));
+			DynamicSerDes<buf_t, big_endian>::template write_command_header<class_id, func_id>(out.data() + pos, payload_size);
+			header_done = true;
+			arg_idx = 0;
+			if (measured >= budget)
+				return false;
+		}
+		while (arg_idx < arg_nums && out.size() < limit)
+			encode_arg<0>(out, limit);
+		return arg_idx == arg_nums;
+	}
+
+private:
+	template<size_t idx>
+	inline std::enable_if_t<!(idx < arg_nums)> size_arg(size_t&, size_t) {}
+
+	template<size_t idx>
+	inline std::enable_if_t<(idx < arg_nums)> size_arg(size_t& measured, size_t budget) {
+		if (arg_idx != idx)
+			return size_arg<idx + 1>(measured, budget);
+		size_value(std::get<idx>(args), measured, budget);
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_container_v<Tp>> size_value(const Tp& vec, size_t& measured, size_t budget) {
+		using elem_Tp = typename Tp::value_type;
+		if (elem_idx == 0)
+			payload_size += serdes_type::count_size(vec.size());
+		if (serdes_type::template is_fixed_size<elem_Tp>()) {
+			payload_size += (uint64_t)serdes_type::template fixed_size<elem_Tp>() * (vec.size() - elem_idx);
+			elem_idx = vec.size();
+		}
+		else {
+			auto it = std::next(vec.begin(), (std::ptrdiff_t)elem_idx);
+			for (; elem_idx < vec.size() && measured < budget; ++it, elem_idx++) {
+				const size_t elem_size = serdes_type::payload_size(*it);
+				payload_size += elem_size;
+				measured += elem_size;
+			}
+		}
+		if (elem_idx == vec.size()) {
+			arg_idx++;
+			elem_idx = 0;
+		}
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<!serdes::is_container_v<Tp>> size_value(const Tp& value, size_t& measured, size_t) {
+		const size_t size = serdes_type::payload_size(value);
+		payload_size += size;
+		measured += size;
+		arg_idx++;
+	}
+
+	template<size_t idx>
+	inline std::enable_if_t<!(idx < arg_nums)> encode_arg(std::vector<buf_t>&, size_t) {}
+
+	template<size_t idx>
+	inline std::enable_if_t<(idx < arg_nums)> encode_arg(std::vector<buf_t>& out, size_t limit) {
+		if (arg_idx != idx)
+			return encode_arg<idx + 1>(out, limit);
+		encode_value(std::get<idx>(args), out, limit);
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_container_v<Tp>> encode_value(const Tp& vec, std::vector<buf_t>& out, size_t limit) {
+		using elem_Tp = typename Tp::value_type;
+		if (elem_idx == 0 && !count_done) {
+			const size_t pos = out.size();
+			out.resize(pos + serdes_type::count_size(vec.size()));
+			serdes_type::inject_count(out.data() + pos, vec.size());
+			count_done = true;
+		}
+		auto it = std::next(vec.begin(), (std::ptrdiff_t)elem_idx);
+		if (serdes_type::template is_fixed_size<elem_Tp>()) { // one resize per slice
+			const size_t elem_size = serdes_type::template fixed_size<elem_Tp>();
+			const size_t room = out.size() < limit ? (limit - out.size() + elem_size - 1) / elem_size : 1;
+			const size_t nums = std::min(vec.size() - elem_idx, std::max<size_t>(room, 1));
+			size_t pos = out.size();
+			out.resize(pos + nums * elem_size);
+			for (size_t i = 0; i < nums; i++, ++it, pos += elem_size)
+				serdes_type::serialize(out.data() + pos, *it);
+			elem_idx += nums;
+		}
+		else {
+			for (; elem_idx < vec.size() && out.size() < limit; ++it, elem_idx++)
+				append(out, *it);
+		}
+		if (elem_idx == vec.size())
+			next_arg();
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<!serdes::is_container_v<Tp>> encode_value(const Tp& value, std::vector<buf_t>& out, size_t) {
+		append(out, value);
+		next_arg();
+	}
+
+	template<typename Tp>
+	static inline void append(std::vector<buf_t>& out, const Tp& value) {
+		const size_t pos = out.size();
+		out.resize(pos + serdes_type::payload_size(value));
+		serdes_type::serialize(out.data() + pos, value);
+	}
+
+	inline void next_arg() {
+		arg_idx++;
+		elem_idx = 0;
+		count_done = false;
+	}
+
+	Tup args;
+	uint64_t payload_size = 0; // summed before the header is written
+	bool header_done = false;
+	size_t arg_idx = 0;
+	size_t elem_idx = 0;
+	bool count_done = false;
+};
+
+// Sends command frames to a non-blocking descriptor (socket, pipe) from an event loop.
+// Frames are encoded lazily, one slice per poll(), and only while less than a slice of encoded
+// bytes is waiting for the descriptor, so a slow peer stops the encoding (back-pressure) and
+// a large object never blocks the loop for more than one slice.
+// Sockets are written without SIGPIPE (MSG_NOSIGNAL, or SO_NOSIGPIPE where it is missing) and a
+// closed peer fails the writer with EPIPE. A pipe has no such flag : ignore SIGPIPE to use one.
+template<typename buf_t = uint8_t, bool big_endian = false>
+class AsyncCommandWriter {
+public:
+	typedef std::function<void(bool)> completion; // true : the whole frame was written, otherwise see error()
+
+	// 'fd' is switched to non-blocking. send() refuses new frames while 'max_queued' are pending.
+	explicit AsyncCommandWriter(int fd, size_t slice_bytes = 64 * 1024, size_t max_queued = 64)
+		: out_fd(fd), is_socket(serdes::is_socket(fd)), slice_size(slice_bytes), queue_limit(max_queued) {
+		serdes::set_nonblocking(fd);
+#if !defined(MSG_NOSIGNAL) && defined(SO_NOSIGPIPE)
+		const int on = 1;
+		if (is_socket)
+			::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+	}
+
+	AsyncCommandWriter(const AsyncCommandWriter&) = delete;
+	AsyncCommandWriter& operator=(const AsyncCommandWriter&) = delete;
+
+	// The frames not written yet complete with false (error() : ECANCELED), which also resumes
+	// the coroutines waiting in async_send.
+	~AsyncCommandWriter() {
+		if (!failed)
+			write_error = ECANCELED;
+		fail();
+	}
+
+	// Queues a frame. The arguments are moved (or copied) into the pipeline, so the caller
+	// does not have to keep them alive. Returns false when the queue is full.
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline bool send(completion done, Args&&... args) {
+		if (failed || jobs.size() >= queue_limit)
+			return false;
+		typedef std::tuple<std::decay_t<Args>...> tuple_type;
+		auto encoder = std::make_shared<SlicedCommandEncoder<class_id, func_id, tuple_type, buf_t, big_endian>>(
+			tuple_type(std::forward<Args>(args)...));
+		jobs.push_back(job{ [encoder](std::vector<buf_t>& out, size_t budget) { return (*encoder)(out, budget); },
+			std::move(done) });
+		return true;
+	}
+
+	// Writes what the descriptor accepts and encodes at most one slice.
+	// Call it when the descriptor is writable (see wants_write()).
+	// Returns false on a write error, every pending send then completes with false.
+	inline bool poll() {
+		if (failed)
+			return false;
+		if (!flush())
+			return fail();
+		if (!jobs.empty() && buffered() < slice_size) {
+			if (written > 0) { // drop the written prefix
+				buffer.erase(buffer.begin(), buffer.begin() + (std::ptrdiff_t)written);
+				stream_offset += written;
+				written = 0;
+			}
+			job& current = jobs.front();
+			if (current.encode(buffer, slice_size)) {
+				finished.push_back(finished_frame{ stream_offset + buffer.size(), std::move(current.done) });
+				jobs.pop_front();
+			}
+			if (!flush())
+				return fail();
+		}
+		return true;
+	}
+
+	inline bool wants_write() const { return !jobs.empty() || buffered() > 0; }
+	inline bool idle() const { return !wants_write(); }
+	inline size_t buffered() const { return buffer.size() - written; }
+	inline size_t queued() const { return jobs.size(); }
+	inline int fd() const { return out_fd; }
+
+	// errno of the write that failed the writer (EPIPE : the peer closed), 0 before.
+	// Set when the completions run with false.
+	inline int error() const { return write_error; }
+
+#ifdef SERDES_ASYNC_COROUTINE
+	// co_await writer.async_send<CLASS_ID, FUNC_ID>(args...) resumes with the send result,
+	// from inside the poll() call that completed the frame.
+	class send_awaitable {
+	public:
+		struct state {
+			bool done = false;
+			bool ok = false;
+			std::coroutine_handle<> waiter;
+		};
+
+		explicit send_awaitable(std::shared_ptr<state> st) : shared(std::move(st)) {}
+		inline bool await_ready() const noexcept { return shared->done; }
+		inline void await_suspend(std::coroutine_handle<> handle) noexcept { shared->waiter = handle; }
+		inline bool await_resume() const noexcept { return shared->ok; }
+
+	private:
+		std::shared_ptr<state> shared;
+	};
+
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline send_awaitable async_send(Args&&... args) {
+		auto st = std::make_shared<typename send_awaitable::state>();
+		const bool queued_ok = send<class_id, func_id>([st](bool ok) {
+			st->done = true;
+			st->ok = ok;
+			if (st->waiter)
+				st->waiter.resume();
+		}, std::forward<Args>(args)...);
+		if (!queued_ok)
+			st->done = true;
+		return send_awaitable(st);
+	}
+#endif // !SERDES_ASYNC_COROUTINE
+
+private:
+	struct job {
+		std::function<bool(std::vector<buf_t>&, size_t)> encode;
+		completion done;
+	};
+
+	struct finished_frame {
+		uint64_t end; // stream offset of the frame end
+		completion done;
+	};
+
+	// Non-blocking write of the buffered bytes, completes the frames fully written.
+	inline bool flush() {
+		while (written < buffer.size()) {
+			const ssize_t n = write_some(buffer.data() + written, buffer.size() - written);
+			if (n < 0) {
+				if (errno == EINTR)
+					continue;
+				if (errno == EAGAIN)
+					break;
+				write_error = errno;
+				return false;
+			}
+			written += (size_t)n;
+		}
+		if (written == buffer.size()) {
+			stream_offset += buffer.size();
+			buffer.clear();
+			written = 0;
+		}
+		// callbacks may send again, so they are run after the queue is updated
+		std::vector<completion> done_now;
+		while (!finished.empty() && finished.front().end <= stream_offset + written) {
+			done_now.push_back(std::move(finished.front().done));
+			finished.pop_front();
+		}
+		for (auto& done : done_now)
+			if (done)
+				done(true);
+		return true;
+	}
+
+	inline ssize_t write_some(const buf_t* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+		if (is_socket)
+			return ::send(out_fd, data, size, MSG_NOSIGNAL);
+#endif
+		return ::write(out_fd, data, size);
+	}
+
+	inline bool fail() {
+		failed = true;
+		std::vector<completion> done_now;
+		for (auto& frame : finished)
+			done_now.push_back(std::move(frame.done));
+		for (auto& pending : jobs)
+			done_now.push_back(std::move(pending.done));
+		finished.clear();
+		jobs.clear();
+		for (auto& done : done_now)
+			if (done)
+				done(false);
+		return false;
+	}
+
+	const int out_fd;
+	const bool is_socket;
+	const size_t slice_size;
+	const size_t queue_limit;
+	std::deque<job> jobs;
+	std::deque<finished_frame> finished;
+	std::vector<buf_t> buffer;
+	size_t written = 0;         // bytes of 'buffer' already written
+	uint64_t stream_offset = 0; // bytes written before 'buffer'
+	bool failed = false;
+	int write_error = 0;
+};
+
+#endif // !__SERDES_ASYNC_HPP__
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef __SERDES_BATCH_HPP__
+#define __SERDES_BATCH_HPP__
+
+#include "serializer_deserializer.hpp"
+#include <chrono>
+#include <functional>
+
+//--------------------------------------------------------------------------------------------------
+// Coalescing command writer
+//--------------------------------------------------------------------------------------------------
+
+// Appends successive command frames (same frames as build_command) to one contiguous buffer
+// and hands them to the sink in a single call, once 'flush_bytes' are pending, once the oldest
+// pending frame is 'max_delay' old (checked by poll()), or on flush(). Like Nagle's algorithm,
+// it trades a bounded delay for fewer writes. In bypass mode, or with send_now(), a frame is
+// written at once, after the frames already pending, so the order is kept.
+template<typename buf_t = uint8_t, bool big_endian = false, typename stats_policy = serdes::no_stats>
+class CoalescingWriter {
+public:
+	typedef std::chrono::steady_clock clock;
+	typedef std::function<bool(const buf_t*, size_t)> sink; // one write of the whole batch, false on error
+
+	enum class mode {
+		coalesce,
+		bypass,
+	};
+
+	// Without a sink, the caller takes the batch from data() / size() and calls clear().
+	explicit CoalescingWriter(sink out = sink(), size_t flush_bytes = 16 * 1024,
+		clock::duration max_delay = std::chrono::microseconds(200))
+		: output(std::move(out)), flush_size(flush_bytes), delay(max_delay) {}
+
+	inline void set_mode(mode m) { send_mode = m; }
+	inline mode get_mode() const { return send_mode; }
+	inline void set_flush_bytes(size_t flush_bytes) { flush_size = flush_bytes; }
+	inline void set_max_delay(clock::duration max_delay) { delay = max_delay; }
+
+	// Compression threshold, size hints...
+	inline DynamicSerDes<buf_t, big_endian, stats_policy>& dynamic_serdes() { return dyn_serdes; }
+
+	// Appends a frame, writes the batch if it reached 'flush_bytes' or in bypass mode.
+	// Returns false when a write failed (the batch is kept for the next flush).
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline bool send(const Args&... args) {
+		append<class_id, func_id>(args...);
+		if (send_mode == mode::bypass || buffer.size() >= flush_size)
+			return flush();
+		return true;
+	}
+
+	// Appends a frame and writes the batch, whatever the mode (latency sensitive commands).
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline bool send_now(const Args&... args) {
+		append<class_id, func_id>(args...);
+		return flush();
+	}
+
+	// Writes the batch if its oldest frame reached the deadline. Call it from the event loop
+	// or a timer, deadline() tells when.
+	inline bool poll(clock::time_point now = clock::now()) {
+		if (buffer.empty() || now < oldest + delay)
+			return true;
+		return flush();
+	}
+
+	// Time of the next flush by poll(), clock::time_point::max() when nothing is pending.
+	inline clock::time_point deadline() const {
+		return buffer.empty() ? clock::time_point::max() : oldest + delay;
+	}
+
+	inline bool flush() {
+		if (buffer.empty() || !output)
+			return true;
+		if (!output(buffer.data(), buffer.size()))
+			return false;
+		clear();
+		return true;
+	}
+
+	// The pending batch, as one span
+	inline const buf_t* data() const { return buffer.data(); }
+	inline size_t size() const { return buffer.size(); }
+	inline size_t frames() const { return frame_nums; }
+	inline bool empty() const { return buffer.empty(); }
+
+	// Drops the pending batch (after the caller wrote it), the buffer capacity is kept.
+	inline void clear() {
+		buffer.clear();
+		frame_nums = 0;
+	}
+
+private:
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline void append(const Args&... args) {
+		if (buffer.empty())
+			oldest = clock::now();
+		dyn_serdes.template append_command<class_id, func_id>(buffer, args...);
+		frame_nums++;
+	}
+
+	DynamicSerDes<buf_t, big_endian, stats_policy> dyn_serdes;
+	sink output;
+	size_t flush_size;
+	clock::duration delay;
+	mode send_mode = mode::coalesce;
+	std::vector<buf_t> buffer;
+	size_t frame_nums = 0;
+	clock::time_point oldest;
+};
+
+#endif // !__SERDES_BATCH_HPP__
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef __SERDES_CODEC_HPP__
+#define __SERDES_CODEC_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//--------------------------------------------------------------------------------------------------
+// Explicitly instantiated message codecs
+//--------------------------------------------------------------------------------------------------
+
+// SerDes entry points of one message type, compiled once in a codec library instead of in every
+// translation unit using the type. This header does not include serializer_deserializer.hpp.
+//   messages.hpp : #define MESSAGE_TYPES(X) X(login_type) X(quote_type)
+//                  MESSAGE_TYPES(SERDES_EXTERN_CODEC)
+//   messages.cpp : #include "serdes_codec_impl.hpp"
+//                  #include "messages.hpp"
+//                  MESSAGE_TYPES(SERDES_INSTANTIATE_CODEC)
+// With SERDES_CODEC_HEADER_ONLY defined, every translation unit instantiates its codecs
+// (no codec library to link).
+template<typename Tp, typename buf_t = uint8_t, bool big_endian = false>
+class MessageCodec {
+public:
+	static size_t payload_size(const Tp& src);
+	static size_t serialize(buf_t* ptr, const Tp& src);
+	static size_t deserialize(Tp& dst, const buf_t* ptr);
+	static size_t deserialize_checked(Tp& dst, const buf_t* ptr, size_t size);
+
+	// Appends the encoding of 'src' to 'out', returns its size.
+	static size_t append(std::vector<buf_t>& out, const Tp& src);
+};
+
+#ifdef SERDES_CODEC_HEADER_ONLY
+#include "serdes_codec_impl.hpp"
+#define SERDES_EXTERN_CODEC(...)
+#else
+#define SERDES_EXTERN_CODEC(...) extern template class MessageCodec<__VA_ARGS__>;
+#endif // !SERDES_CODEC_HEADER_ONLY
+
+#define SERDES_INSTANTIATE_CODEC(...) template class MessageCodec<__VA_ARGS__>;
+
+#endif // !__SERDES_CODEC_HPP__
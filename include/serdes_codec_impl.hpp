@@ -0,0 +1,40 @@
+#pragma once
+#ifndef __SERDES_CODEC_IMPL_HPP__
+#define __SERDES_CODEC_IMPL_HPP__
+
+#include "serializer_deserializer.hpp"
+#include "serdes_codec.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// MessageCodec definitions, for the codec library (or SERDES_CODEC_HEADER_ONLY)
+//--------------------------------------------------------------------------------------------------
+
+// Not inline, so an extern template declaration keeps them out of the user translation units.
+template<typename Tp, typename buf_t, bool big_endian>
+size_t MessageCodec<Tp, buf_t, big_endian>::payload_size(const Tp& src) {
+	return SerDes<buf_t, big_endian>::payload_size(src);
+}
+
+template<typename Tp, typename buf_t, bool big_endian>
+size_t MessageCodec<Tp, buf_t, big_endian>::serialize(buf_t* ptr, const Tp& src) {
+	return SerDes<buf_t, big_endian>::serialize(ptr, src);
+}
+
+template<typename Tp, typename buf_t, bool big_endian>
+size_t MessageCodec<Tp, buf_t, big_endian>::deserialize(Tp& dst, const buf_t* ptr) {
+	return SerDes<buf_t, big_endian>::deserialize(dst, ptr);
+}
+
+template<typename Tp, typename buf_t, bool big_endian>
+size_t MessageCodec<Tp, buf_t, big_endian>::deserialize_checked(Tp& dst, const buf_t* ptr, size_t size) {
+	return SerDes<buf_t, big_endian>::deserialize_checked(dst, ptr, size);
+}
+
+template<typename Tp, typename buf_t, bool big_endian>
+size_t MessageCodec<Tp, buf_t, big_endian>::append(std::vector<buf_t>& out, const Tp& src) {
+	const size_t pos = out.size();
+	out.resize(pos + SerDes<buf_t, big_endian>::payload_size(src));
+	return SerDes<buf_t, big_endian>::serialize(out.data() + pos, src);
+}
+
+#endif // !__SERDES_CODEC_IMPL_HPP__
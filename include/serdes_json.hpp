@@ -0,0 +1,421 @@
+#pragma once
+#ifndef __SERDES_JSON_HPP__
+#define __SERDES_JSON_HPP__
+
+#include "serializer_deserializer.hpp"
+
+//--------------------------------------------------------------------------------------------------
+// JSON to wire format
+//--------------------------------------------------------------------------------------------------
+
+// Writes the SerDes encoding of a 'Tp' straight from JSON text, in one pass and without
+// building the 'Tp' object. The accepted JSON is what SerDes::format_json writes :
+//  - tuples, std::array and containers : arrays (std::array and tuples of the exact size)
+//  - std::vector<bool> : arrays of true / false
+//  - std::string and c strings : strings
+//  - maps with std::string keys : objects, other maps : arrays of [key, value], sets : arrays
+//  - optional : null or the value, variant : the first alternative that parses
+//  - floating point : numbers, null for nan
+// User structures have no JSON form and are rejected.
+template<typename buf_t = uint8_t, bool big_endian = false>
+class JsonEncoder {
+	typedef SerDes<buf_t, big_endian> serdes_type;
+public:
+	// Appends the encoding to 'dst'. On error 'dst' is left unchanged and error_position()
+	// is the offset in 'json' where parsing stopped.
+	template<typename Tp>
+	inline bool encode(std::vector<buf_t>& dst, const char* json, size_t size) {
+		static_assert(serdes_type::template is_serdesable_v<Tp>, "cannot convert");
+		begin = cursor = json;
+		end = json + size;
+		const size_t base = dst.size();
+		if (!parse_value<Tp>(dst) || (skip_space(), cursor != end)) {
+			dst.resize(base);
+			return false;
+		}
+		return true;
+	}
+
+	template<typename Tp>
+	inline bool encode(std::vector<buf_t>& dst, const std::string& json) {
+		return encode<Tp>(dst, json.data(), json.size());
+	}
+
+	inline size_t error_position() const { return (size_t)(cursor - begin); }
+
+private:
+	//----------------------------------------------------------------------------------------------
+	// Tokens
+	//----------------------------------------------------------------------------------------------
+
+	inline void skip_space() {
+		while (cursor != end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t'))
+			cursor++;
+	}
+
+	// Skips spaces and consumes 'ch' when it is next
+	inline bool accept(char ch) {
+		skip_space();
+		if (cursor == end || *cursor != ch)
+			return false;
+		cursor++;
+		return true;
+	}
+
+	inline bool accept_word(const char* word, size_t length) {
+		skip_space();
+		if ((size_t)(end - cursor) < length || memcmp(cursor, word, length) != 0)
+			return false;
+		cursor += length;
+		return true;
+	}
+
+	// Elements of an array or members of an object, 'close' ends the list
+	template<typename Fn>
+	inline bool parse_list(char close, size_t& count, Fn&& parse_element) {
+		count = 0;
+		if (accept(close))
+			return true;
+		do {
+			if (!parse_element())
+				return false;
+			count++;
+		} while (accept(','));
+		return accept(close);
+	}
+
+	// Numbers are copied to a terminated buffer, the input does not have to be terminated.
+	inline size_t number_token(char (&token)[64]) {
+		skip_space();
+		size_t length = 0;
+		while (cursor + length != end && length < sizeof(token) - 1 &&
+			strchr("+-.0123456789eE", cursor[length]) != nullptr && cursor[length] != '\0')
+			length++;
+		memcpy(token, cursor, length);
+		token[length] = '\0';
+		return length;
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Output
+	//----------------------------------------------------------------------------------------------
+
+	template<typename Tp>
+	static inline void append(std::vector<buf_t>& dst, const Tp& value) {
+		const size_t pos = dst.size();
+		dst.resize(pos + sizeof(Tp));
+		serdes_type::inject(dst.data() + pos, value);
+	}
+
+	// Counts are written once the elements are known, a short count slot is reserved first.
+	static inline size_t reserve_count(std::vector<buf_t>& dst) {
+		const size_t pos = dst.size();
+		dst.resize(pos + serdes_type::count_size(0));
+		return pos;
+	}
+
+	static inline void patch_count(std::vector<buf_t>& dst, size_t pos, size_t count) {
+		const size_t extra = serdes_type::count_size(count) - serdes_type::count_size(0);
+		if (extra != 0)
+			dst.insert(dst.begin() + (std::ptrdiff_t)(pos + serdes_type::count_size(0)), extra, buf_t());
+		serdes_type::inject_count(dst.data() + pos, count);
+	}
+
+	static inline void append_utf8(std::vector<buf_t>& dst, uint32_t code) {
+		if (code < 0x80)
+			dst.push_back((buf_t)code);
+		else if (code < 0x800) {
+			dst.push_back((buf_t)(0xC0 | (code >> 6)));
+			dst.push_back((buf_t)(0x80 | (code & 0x3F)));
+		}
+		else if (code < 0x10000) {
+			dst.push_back((buf_t)(0xE0 | (code >> 12)));
+			dst.push_back((buf_t)(0x80 | ((code >> 6) & 0x3F)));
+			dst.push_back((buf_t)(0x80 | (code & 0x3F)));
+		}
+		else {
+			dst.push_back((buf_t)(0xF0 | (code >> 18)));
+			dst.push_back((buf_t)(0x80 | ((code >> 12) & 0x3F)));
+			dst.push_back((buf_t)(0x80 | ((code >> 6) & 0x3F)));
+			dst.push_back((buf_t)(0x80 | (code & 0x3F)));
+		}
+	}
+
+	inline bool hex4(uint32_t& code) {
+		if (end - cursor < 4)
+			return false;
+		code = 0;
+		for (int i = 0; i < 4; i++, cursor++) {
+			const char ch = *cursor;
+			const uint32_t digit = ch >= '0' && ch <= '9' ? (uint32_t)(ch - '0') :
+				ch >= 'a' && ch <= 'f' ? (uint32_t)(ch - 'a' + 10) :
+				ch >= 'A' && ch <= 'F' ? (uint32_t)(ch - 'A' + 10) : 16;
+			if (digit == 16)
+				return false;
+			code = code << 4 | digit;
+		}
+		return true;
+	}
+
+	// Decodes a JSON string straight into a count + characters encoding
+	inline bool parse_string(std::vector<buf_t>& dst) {
+		if (!accept('"'))
+			return false;
+		const size_t count_pos = reserve_count(dst);
+		const size_t chars_pos = dst.size();
+		for (;;) {
+			const char* plain = cursor;
+			while (cursor != end && *cursor != '"' && *cursor != '\\' && (unsigned char)*cursor >= 0x20)
+				cursor++;
+			dst.insert(dst.end(), plain, cursor);
+			if (cursor == end || (unsigned char)*cursor < 0x20)
+				return false;
+			if (*cursor++ == '"')
+				break;
+			if (cursor == end)
+				return false;
+			switch (*cursor++) {
+			case '"': dst.push_back((buf_t)'"'); break;
+			case '\\': dst.push_back((buf_t)'\\'); break;
+			case '/': dst.push_back((buf_t)'/'); break;
+			case 'n': dst.push_back((buf_t)'\n'); break;
+			case 'r': dst.push_back((buf_t)'\r'); break;
+			case 't': dst.push_back((buf_t)'\t'); break;
+			case 'b': dst.push_back((buf_t)'\b'); break;
+			case 'f': dst.push_back((buf_t)'\f'); break;
+			case 'u': {
+				uint32_t code;
+				if (!hex4(code))
+					return false;
+				if (code >= 0xD800 && code < 0xDC00) { // surrogate pair
+					uint32_t low;
+					if (end - cursor < 2 || cursor[0] != '\\' || cursor[1] != 'u')
+						return false;
+					cursor += 2;
+					if (!hex4(low) || low < 0xDC00 || low >= 0xE000)
+						return false;
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				append_utf8(dst, code);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		patch_count(dst, count_pos, dst.size() - chars_pos);
+		return true;
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Values
+	//----------------------------------------------------------------------------------------------
+
+	template<typename Tp>
+	inline std::enable_if_t<std::is_same<bool, Tp>::value, bool> parse_value(std::vector<buf_t>& dst) {
+		if (accept_word("true", 4))
+			append(dst, true);
+		else if (accept_word("false", 5))
+			append(dst, false);
+		else
+			return false;
+		return true;
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<std::is_integral<Tp>::value && !std::is_same<bool, Tp>::value, bool> parse_value(std::vector<buf_t>& dst) {
+		skip_space();
+		const bool negative = cursor != end && *cursor == '-';
+		const char* digits = cursor + (negative ? 1 : 0);
+		const char* pos = digits;
+		uint64_t magnitude = 0;
+		for (; pos != end && *pos >= '0' && *pos <= '9'; pos++) {
+			const uint64_t digit = (uint64_t)(*pos - '0');
+			if (magnitude > (UINT64_MAX - digit) / 10)
+				return false;
+			magnitude = magnitude * 10 + digit;
+		}
+		if (pos == digits || (pos != end && (*pos == '.' || *pos == 'e' || *pos == 'E')))
+			return false;
+		Tp value;
+		if (negative) {
+			if (!std::is_signed<Tp>::value || magnitude > (uint64_t)std::numeric_limits<Tp>::max() + 1)
+				return false;
+			value = (Tp)(0 - magnitude);
+		}
+		else {
+			if (magnitude > (uint64_t)std::numeric_limits<Tp>::max())
+				return false;
+			value = (Tp)magnitude;
+		}
+		cursor = pos;
+		append(dst, value);
+		return true;
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<std::is_floating_point<Tp>::value, bool> parse_value(std::vector<buf_t>& dst) {
+		if (accept_word("null", 4)) {
+			append(dst, std::numeric_limits<Tp>::quiet_NaN());
+			return true;
+		}
+		char token[64];
+		const size_t length = number_token(token);
+		Tp value = 0;
+		if (!serdes::parse_c_float(token, length, value))
+			return false;
+		cursor += length;
+		append(dst, value);
+		return true;
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<std::is_same<std::string, Tp>::value || serdes::is_c_string_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		return parse_string(dst);
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_container_v<Tp> && !std::is_same<std::string, Tp>::value, bool> parse_value(std::vector<buf_t>& dst) {
+		if (!accept('['))
+			return false;
+		const size_t count_pos = reserve_count(dst);
+		size_t count;
+		if (!parse_list(']', count, [this, &dst]() { return parse_value<typename Tp::value_type>(dst); }))
+			return false;
+		patch_count(dst, count_pos, count);
+		return true;
+	}
+
+	// std::vector<bool> : an array of true / false, packed 8 per byte from the least significant bit
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_bit_vector_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		if (!accept('['))
+			return false;
+		const size_t count_pos = reserve_count(dst);
+		size_t bits = 0;
+		size_t count;
+		if (!parse_list(']', count, [this, &dst, &bits]() {
+			const bool bit = accept_word("true", 4);
+			if (!bit && !accept_word("false", 5))
+				return false;
+			if (bits % 8 == 0)
+				dst.push_back((buf_t)0);
+			if (bit)
+				dst.back() = (buf_t)((uint8_t)dst.back() | (1U << (bits % 8)));
+			bits++;
+			return true;
+		}))
+			return false;
+		patch_count(dst, count_pos, count);
+		return true;
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_std_array_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		size_t count;
+		return accept('[') &&
+			parse_list(']', count, [this, &dst]() { return parse_value<typename Tp::value_type>(dst); }) &&
+			count == std::tuple_size<Tp>::value;
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		return accept('[') && parse_tuple<Tp>(dst) && accept(']');
+	}
+
+	template<typename Tup, size_t idx = 0>
+	inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), bool> parse_tuple(std::vector<buf_t>&) {
+		return true;
+	}
+
+	template<typename Tup, size_t idx = 0>
+	inline std::enable_if_t<(idx < std::tuple_size<Tup>::value), bool> parse_tuple(std::vector<buf_t>& dst) {
+		return (idx == 0 || accept(',')) &&
+			parse_value<std::decay_t<std::tuple_element_t<idx, Tup>>>(dst) &&
+			parse_tuple<Tup, idx + 1>(dst);
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_associative_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		const bool object = is_string_keyed<Tp>();
+		if (!accept(object ? '{' : '['))
+			return false;
+		const size_t count_pos = reserve_count(dst);
+		size_t count;
+		if (!parse_list(object ? '}' : ']', count, [this, &dst]() { return parse_entry<Tp>(dst); }))
+			return false;
+		patch_count(dst, count_pos, count);
+		return true;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::has_mapped_type<Tp>::value, bool> is_string_keyed() {
+		return std::is_same<std::string, typename Tp::key_type>::value;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<!serdes::has_mapped_type<Tp>::value, bool> is_string_keyed() {
+		return false;
+	}
+
+	// map entry : "key": value in objects, [key, value] otherwise
+	template<typename Tp>
+	inline std::enable_if_t<serdes::has_mapped_type<Tp>::value, bool> parse_entry(std::vector<buf_t>& dst) {
+		typedef typename Tp::key_type key_type;
+		typedef typename Tp::mapped_type mapped_type;
+		if (is_string_keyed<Tp>())
+			return parse_value<key_type>(dst) && accept(':') && parse_value<mapped_type>(dst);
+		return accept('[') && parse_value<key_type>(dst) && accept(',') && parse_value<mapped_type>(dst) && accept(']');
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<!serdes::has_mapped_type<Tp>::value, bool> parse_entry(std::vector<buf_t>& dst) {
+		return parse_value<typename Tp::key_type>(dst);
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<!serdes::is_container_v<Tp> && !serdes::is_std_array_v<Tp> && !serdes::is_std_tuple_v<Tp> &&
+		!serdes::is_c_string_v<Tp> && !serdes::is_associative_v<Tp> && !serdes::is_std_optional_v<Tp> &&
+		!serdes::is_std_variant_v<Tp> && !serdes::is_bit_vector_v<Tp> && !std::is_arithmetic<Tp>::value, bool> parse_value(std::vector<buf_t>&) {
+		return false; // no JSON form for user structures
+	}
+
+#if __cplusplus >= 201703L
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_std_optional_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		if (accept_word("null", 4)) {
+			append<uint8_t>(dst, 0);
+			return true;
+		}
+		append<uint8_t>(dst, 1);
+		return parse_value<typename Tp::value_type>(dst);
+	}
+
+	// Alternatives are tried in order, a failed attempt is rolled back.
+	template<typename Tp>
+	inline std::enable_if_t<serdes::is_std_variant_v<Tp>, bool> parse_value(std::vector<buf_t>& dst) {
+		return parse_alternative<Tp, 0>(dst, cursor, dst.size());
+	}
+
+	template<typename Var, size_t idx>
+	inline std::enable_if_t<!(idx < std::variant_size<Var>::value), bool> parse_alternative(std::vector<buf_t>&, const char*, size_t) {
+		return false;
+	}
+
+	template<typename Var, size_t idx>
+	inline std::enable_if_t<(idx < std::variant_size<Var>::value), bool> parse_alternative(std::vector<buf_t>& dst, const char* start, size_t base) {
+		append<uint8_t>(dst, (uint8_t)idx);
+		if (parse_value<std::variant_alternative_t<idx, Var>>(dst))
+			return true;
+		cursor = start;
+		dst.resize(base);
+		return parse_alternative<Var, idx + 1>(dst, start, base);
+	}
+#endif
+
+	const char* begin = nullptr;
+	const char* cursor = nullptr;
+	const char* end = nullptr;
+};
+
+#endif // !__SERDES_JSON_HPP__
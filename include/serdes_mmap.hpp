@@ -0,0 +1,177 @@
+#pragma once
+#ifndef __SERDES_MMAP_HPP__
+#define __SERDES_MMAP_HPP__
+
+#include "serializer_deserializer.hpp"
+#include <string>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//--------------------------------------------------------------------------------------------------
+// Memory mapped file (POSIX)
+//--------------------------------------------------------------------------------------------------
+
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile() {
+		close();
+	}
+
+	// Creates (or truncates) a file of 'size' bytes mapped read/write.
+	inline bool create(const char* path, size_t size) {
+		close();
+		fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0)
+			return false;
+		if (::ftruncate(fd, (off_t)size) != 0 || !map(size, PROT_READ | PROT_WRITE)) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	// Maps an existing file read-only.
+	inline bool open(const char* path) {
+		close();
+		fd = ::open(path, O_RDONLY);
+		struct stat st;
+		if (fd < 0 || ::fstat(fd, &st) != 0 || !map((size_t)st.st_size, PROT_READ)) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	inline bool sync() {
+		return addr == nullptr || ::msync(addr, length, MS_SYNC) == 0;
+	}
+
+	inline void close() {
+		if (addr)
+			::munmap(addr, length);
+		if (fd >= 0)
+			::close(fd);
+		addr = nullptr;
+		length = 0;
+		fd = -1;
+	}
+
+	// Access pattern hint for the kernel read-ahead (e.g. MADV_RANDOM for lazy access)
+	inline void advise(int advice) {
+		if (addr)
+			::madvise(addr, length, advice);
+	}
+
+	inline uint8_t* data() { return (uint8_t*)addr; }
+	inline const uint8_t* data() const { return (const uint8_t*)addr; }
+	inline size_t size() const { return length; }
+	inline bool is_open() const { return fd >= 0; }
+
+private:
+	inline bool map(size_t size, int prot) {
+		length = size;
+		if (size == 0) // mmap of zero length is not allowed
+			return true;
+		void* mapped = ::mmap(nullptr, size, prot, MAP_SHARED, fd, 0);
+		if (mapped == MAP_FAILED)
+			return false;
+		addr = mapped;
+		return true;
+	}
+
+	int fd = -1;
+	void* addr = nullptr;
+	size_t length = 0;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Serialized snapshot file
+//--------------------------------------------------------------------------------------------------
+
+// File layout : magic(uint32_t) + payload size(uint64_t) + serialized payload.
+// save() serializes directly into the mapped file, open() maps it, validates the payload once
+// (counts within the file, no decoding) and exposes a LazyView, so reads of the view stay in bounds.
+template<typename buf_t = uint8_t, bool big_endian = false>
+class SnapshotFile {
+public:
+	typedef std::tuple<uint32_t, uint64_t> file_header_type;
+	static constexpr uint32_t magic = 0x53445331; // "SDS1"
+	static constexpr size_t file_header_size = sizeof(uint32_t) + sizeof(uint64_t);
+
+	// Written to "<path>.tmp" and renamed, so a crash never leaves a partial snapshot at 'path'.
+	// The parent directory is synced after the rename, so the new entry survives a crash too.
+	template<typename Tp>
+	static inline bool save(const char* path, const Tp& src) {
+		static_assert(SerDes<buf_t, big_endian>::template is_serdesable_v<Tp>, "cannot convert");
+		const std::string tmp_path = std::string(path) + ".tmp";
+		const size_t payload_size = SerDes<buf_t, big_endian>::payload_size(src);
+
+		MappedFile file;
+		if (!file.create(tmp_path.c_str(), file_header_size + payload_size))
+			return false;
+		buf_t* ptr = (buf_t*)file.data();
+		SerDes<buf_t, big_endian>::serialize(ptr, file_header_type((uint32_t)magic, (uint64_t)payload_size));
+		const size_t written = SerDes<buf_t, big_endian>::serialize(ptr + file_header_size, src);
+		assert(written == payload_size && "converting size error");
+		UNUSED(written);
+		if (!file.sync())
+			return false;
+		file.close();
+		return ::rename(tmp_path.c_str(), path) == 0 && sync_parent(path);
+	}
+
+	// Maps a snapshot of 'Tp', false when the header does not match or the payload is malformed.
+	template<typename Tp>
+	inline bool open(const char* path) {
+		if (!file.open(path) || file.size() < file_header_size)
+			return false;
+		file_header_type header;
+		SerDes<buf_t, big_endian>::deserialize(header, payload() - file_header_size);
+		if (std::get<0>(header) != magic || std::get<1>(header) != file.size() - file_header_size ||
+			SerDes<buf_t, big_endian>::template validate<Tp>(payload(), payload_size()) != payload_size()) {
+			file.close();
+			return false;
+		}
+		file.advise(MADV_RANDOM);
+		return true;
+	}
+
+	// View of the 'Tp' validated by open()
+	template<typename Tp>
+	inline typename SerDes<buf_t, big_endian>::template LazyView<Tp> view() const {
+		return typename SerDes<buf_t, big_endian>::template LazyView<Tp>(payload());
+	}
+
+	// Full decode, for callers that need the whole object anyway.
+	template<typename Tp>
+	inline bool load(Tp& dst) const {
+		return SerDes<buf_t, big_endian>::deserialize_checked(dst, payload(), payload_size()) == payload_size();
+	}
+
+	inline const buf_t* payload() const { return (const buf_t*)file.data() + file_header_size; }
+	inline size_t payload_size() const { return file.size() - file_header_size; }
+
+private:
+	static inline bool sync_parent(const char* path) {
+		const std::string name(path);
+		const size_t slash = name.find_last_of('/');
+		const std::string dir = slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : name.substr(0, slash);
+		const int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+		if (dir_fd < 0)
+			return false;
+		const bool synced = ::fsync(dir_fd) == 0;
+		::close(dir_fd);
+		return synced;
+	}
+
+	MappedFile file;
+};
+
+#endif // !__SERDES_MMAP_HPP__
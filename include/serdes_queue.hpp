@@ -0,0 +1,251 @@
+#pragma once
+#ifndef __SERDES_QUEUE_HPP__
+#define __SERDES_QUEUE_HPP__
+
+#include "serializer_deserializer.hpp"
+#include <atomic>
+#include <memory>
+#include <new>
+
+//--------------------------------------------------------------------------------------------------
+// Lock-free ring buffer of serialized messages
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+
+	static constexpr size_t cache_line_size = 64;
+
+	// Shared state of a ring. head and tail are byte positions that only grow,
+	// each on its own cache line so producers and the consumer do not false-share.
+	struct ring_control {
+		alignas(cache_line_size) std::atomic<uint64_t> head;
+		alignas(cache_line_size) std::atomic<uint64_t> tail;
+		alignas(cache_line_size) uint64_t capacity;
+	};
+
+	// Result of a push. A too_large message never fits, retrying it does not help.
+	enum class push_result {
+		pushed,
+		full,
+		too_large,
+	};
+
+} // namespace serdes
+
+// Variable length messages in a power of two byte ring, placed in caller provided memory
+// (heap for in-process queues, shared pages for IPC).
+// Record : state(uint32_t) + length_header_t + payload, padded to 8 bytes, never split across the end.
+// Producers serialize directly into reserved ring space and the consumer decodes in place.
+//  - multi_producer = false : one producer, the tail is the commit point.
+//  - multi_producer = true  : producers reserve with a CAS on the tail and commit each record
+//    with its state word, consumed space is zeroed so stale bytes are never read as a state.
+template<bool multi_producer, typename buf_t = uint8_t, bool big_endian = false>
+class MessageRing {
+public:
+	static constexpr size_t record_header_size = sizeof(uint32_t) + sizeof(length_header_t);
+	static constexpr size_t record_align = 8;
+
+	struct slot {
+		buf_t* data; // payload, nullptr when the ring is full or size is over max_message_size()
+		size_t size;
+		uint64_t start; // record position
+	};
+
+	static inline size_t memory_size(size_t capacity) {
+		return sizeof(serdes::ring_control) + capacity;
+	}
+
+	// 'memory' holds memory_size(capacity) bytes aligned to cache_line_size, capacity is a power of two.
+	// Only one side initializes a shared ring, the others attach to it.
+	MessageRing(void* memory, size_t capacity, bool initialize)
+		: control(static_cast<serdes::ring_control*>(memory))
+		, ring(static_cast<buf_t*>(memory) + sizeof(serdes::ring_control))
+		, mask(capacity - 1) {
+		assert(capacity >= 64 && (capacity & (capacity - 1)) == 0 && "capacity must be a power of two");
+		assert(((uintptr_t)memory % serdes::cache_line_size) == 0 && "unaligned ring memory");
+		if (initialize) {
+			memset(memory, 0, memory_size(capacity));
+			new (&control->head) std::atomic<uint64_t>(0);
+			new (&control->tail) std::atomic<uint64_t>(0);
+			control->capacity = capacity;
+		}
+	}
+
+	inline size_t capacity() const { return mask + 1; }
+
+	// Largest payload that can ever be reserved
+	inline size_t max_message_size() const {
+		return std::min<size_t>(capacity() / 2 - record_header_size, length_header_t::max_packet_size - 1);
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Producer side
+	//----------------------------------------------------------------------------------------------
+
+	inline slot try_reserve(size_t size) {
+		if (size > max_message_size())
+			return slot{ nullptr, size, 0 };
+		const size_t need = record_size(size);
+		uint64_t tail = control->tail.load(std::memory_order_relaxed);
+		uint64_t start, end;
+		for (;;) {
+			const size_t contiguous = capacity() - (size_t)(tail & mask);
+			start = need <= contiguous ? tail : tail + contiguous;
+			end = start + need;
+			uint64_t head = multi_producer ? control->head.load(std::memory_order_acquire) : producer_head;
+			if (end - head > capacity() && !multi_producer)
+				head = producer_head = control->head.load(std::memory_order_acquire);
+			if (end - head > capacity())
+				return slot{ nullptr, size, 0 };
+			if (!multi_producer)
+				break;
+			if (control->tail.compare_exchange_weak(tail, end, std::memory_order_relaxed))
+				break;
+		}
+		if (start != tail) // padding up to the end of the ring
+			state(tail).store(state_wrap, std::memory_order_release);
+		return slot{ ring + (start & mask) + record_header_size, size, start };
+	}
+
+	inline void commit(const slot& reserved) {
+		buf_t* record = ring + (reserved.start & mask);
+		SerDes<buf_t, big_endian>::inject(record + sizeof(uint32_t), length_header_t((uint32_t)reserved.size));
+		state(reserved.start).store(state_message, std::memory_order_release);
+		if (!multi_producer)
+			control->tail.store(reserved.start + record_size(reserved.size), std::memory_order_release);
+	}
+
+	// Serializes 'src' straight into the ring.
+	template<typename Tp>
+	inline serdes::push_result try_push(const Tp& src) {
+		const size_t size = SerDes<buf_t, big_endian>::payload_size(src);
+		if (size > max_message_size())
+			return serdes::push_result::too_large;
+		slot reserved = try_reserve(size);
+		if (!reserved.data)
+			return serdes::push_result::full;
+		SerDes<buf_t, big_endian>::serialize(reserved.data, src);
+		commit(reserved);
+		return serdes::push_result::pushed;
+	}
+
+	// Same frame as DynamicSerDes::build_command, built in the ring.
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline serdes::push_result try_push_command(const Args&... args) {
+		const size_t size = DynamicSerDes<buf_t, big_endian>::command_size(args...);
+		if (size > max_message_size())
+			return serdes::push_result::too_large;
+		slot reserved = try_reserve(size);
+		if (!reserved.data)
+			return serdes::push_result::full;
+		DynamicSerDes<buf_t, big_endian>::template write_command<class_id, func_id>(reserved.data, args...);
+		commit(reserved);
+		return serdes::push_result::pushed;
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Consumer side (single consumer)
+	//----------------------------------------------------------------------------------------------
+
+	// Oldest committed message, valid until pop(). Returns nullptr when empty.
+	inline const buf_t* front(size_t& size) {
+		for (;;) {
+			const uint64_t head = control->head.load(std::memory_order_relaxed);
+			if (!multi_producer && head == consumer_tail) {
+				consumer_tail = control->tail.load(std::memory_order_acquire);
+				if (head == consumer_tail)
+					return nullptr;
+			}
+			const uint32_t record_state = state(head).load(std::memory_order_acquire);
+			if (record_state == state_empty)
+				return nullptr;
+			if (record_state == state_wrap) {
+				release(head, capacity() - (size_t)(head & mask));
+				continue;
+			}
+			const buf_t* record = ring + (head & mask);
+			length_header_t len_header;
+			SerDes<buf_t, big_endian>::deserialize(len_header, record + sizeof(uint32_t));
+			front_size = size = len_header.length;
+			return record + record_header_size;
+		}
+	}
+
+	inline void pop() {
+		release(control->head.load(std::memory_order_relaxed), record_size(front_size));
+	}
+
+	// Decodes the oldest message in place, returns false when empty.
+	template<typename Tp>
+	inline bool try_pop(Tp& dst) {
+		size_t size;
+		const buf_t* data = front(size);
+		if (!data)
+			return false;
+		SerDes<buf_t, big_endian>::deserialize(dst, data);
+		pop();
+		return true;
+	}
+
+private:
+	static constexpr uint32_t state_empty = 0;
+	static constexpr uint32_t state_message = 1;
+	static constexpr uint32_t state_wrap = 2;
+
+	static inline size_t record_size(size_t size) {
+		return (record_header_size + size + record_align - 1) & ~(record_align - 1);
+	}
+
+	inline std::atomic<uint32_t>& state(uint64_t pos) {
+		return *static_cast<std::atomic<uint32_t>*>(static_cast<void*>(ring + (pos & mask)));
+	}
+
+	inline void release(uint64_t head, size_t size) {
+		if (multi_producer)
+			memset(ring + (head & mask), 0, size);
+		control->head.store(head + size, std::memory_order_release);
+	}
+
+	serdes::ring_control* const control;
+	buf_t* const ring;
+	const size_t mask;
+
+	// padded rather than over-aligned, so rings can be allocated with plain new
+	uint8_t producer_pad[serdes::cache_line_size];
+	uint64_t producer_head = 0; // cached head, single producer only
+	uint8_t consumer_pad[serdes::cache_line_size];
+	uint64_t consumer_tail = 0; // cached tail
+	size_t front_size = 0;
+};
+
+// MessageRing owning heap memory
+template<bool multi_producer, typename buf_t = uint8_t, bool big_endian = false>
+class MessageQueue : public MessageRing<multi_producer, buf_t, big_endian> {
+	typedef MessageRing<multi_producer, buf_t, big_endian> ring_type;
+public:
+	explicit MessageQueue(size_t capacity)
+		: MessageQueue(allocate(capacity), capacity) {}
+
+private:
+	MessageQueue(std::unique_ptr<uint8_t[]>&& mem, size_t capacity)
+		: ring_type(align(mem.get()), capacity, true)
+		, memory(std::move(mem)) {}
+
+	static inline std::unique_ptr<uint8_t[]> allocate(size_t capacity) {
+		return std::unique_ptr<uint8_t[]>(new uint8_t[ring_type::memory_size(capacity) + serdes::cache_line_size]);
+	}
+
+	static inline void* align(uint8_t* ptr) {
+		return ptr + (serdes::cache_line_size - (uintptr_t)ptr % serdes::cache_line_size) % serdes::cache_line_size;
+	}
+
+	std::unique_ptr<uint8_t[]> memory;
+};
+
+template<typename buf_t = uint8_t, bool big_endian = false>
+using SpscMessageQueue = MessageQueue<false, buf_t, big_endian>;
+
+template<typename buf_t = uint8_t, bool big_endian = false>
+using MpscMessageQueue = MessageQueue<true, buf_t, big_endian>;
+
+#endif // !__SERDES_QUEUE_HPP__
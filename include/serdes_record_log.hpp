@@ -0,0 +1,332 @@
+#pragma once
+#ifndef __SERDES_RECORD_LOG_HPP__
+#define __SERDES_RECORD_LOG_HPP__
+
+#include "serializer_deserializer.hpp"
+#include "serdes_mmap.hpp"
+#include <string>
+#include <iterator>
+#include <cerrno>
+
+//--------------------------------------------------------------------------------------------------
+// Append-only record log (POSIX)
+//--------------------------------------------------------------------------------------------------
+
+// A log file is a sequence of command frames (header_type / extended_header_type framing).
+// Every index_interval-th record offset is appended to "<path>.idx" as (record number, file offset),
+// which gives an O(log n) seek to any record. A torn tail after a crash is dropped on open.
+
+namespace serdes {
+
+	typedef std::tuple<uint64_t, uint64_t> log_index_entry; // record number, file offset
+	static constexpr size_t log_index_entry_size = sizeof(uint64_t) * 2;
+	static constexpr uint64_t default_index_interval = 64;
+
+	// 'written' receives the bytes written, also when a later write() fails.
+	inline bool write_all(int fd, const void* data, size_t size, size_t& written) {
+		const uint8_t* ptr = (const uint8_t*)data;
+		written = 0;
+		while (written < size) {
+			const ssize_t bytes = ::write(fd, ptr + written, size - written);
+			if (bytes < 0) {
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			written += (size_t)bytes;
+		}
+		return true;
+	}
+
+	inline bool write_all(int fd, const void* data, size_t size) {
+		size_t written;
+		return write_all(fd, data, size, written);
+	}
+
+	inline std::string log_index_path(const char* path) {
+		return std::string(path) + ".idx";
+	}
+
+} // namespace serdes
+
+template<typename buf_t = uint8_t, bool big_endian = false>
+class RecordLogReader {
+public:
+	struct record {
+		const buf_t* frame;
+		size_t size;
+	};
+
+	class iterator {
+	public:
+		typedef std::forward_iterator_tag iterator_category;
+		typedef record value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const record* pointer;
+		typedef const record& reference;
+
+		iterator() : rec{ nullptr, 0 }, end(nullptr) {}
+		iterator(const buf_t* ptr, const buf_t* end_ptr) : rec{ ptr, 0 }, end(end_ptr) {
+			load();
+		}
+
+		inline reference operator*() const { return rec; }
+		inline pointer operator->() const { return &rec; }
+
+		inline iterator& operator++() {
+			rec.frame += rec.size;
+			load();
+			return *this;
+		}
+
+		inline iterator operator++(int) {
+			iterator prev = *this;
+			++(*this);
+			return prev;
+		}
+
+		inline bool operator==(const iterator& other) const { return rec.frame == other.rec.frame; }
+		inline bool operator!=(const iterator& other) const { return rec.frame != other.rec.frame; }
+
+	private:
+		inline void load() {
+			if (rec.frame == end)
+				return;
+			rec.size = DynamicSerDes<buf_t, big_endian>::frame_size(rec.frame, (size_t)(end - rec.frame));
+			if (rec.size == 0) // torn or corrupted tail ends the log
+				rec.frame = end;
+		}
+
+		record rec;
+		const buf_t* end;
+	};
+
+	// Maps the log and loads its index, only the records after the last index entry are scanned.
+	// An index_interval of 0 is rejected.
+	inline bool open(const char* path, uint64_t index_interval = serdes::default_index_interval) {
+		index.clear();
+		records = 0;
+		valid_size = 0;
+		if (index_interval == 0 || !file.open(path))
+			return false;
+		file.advise(MADV_SEQUENTIAL);
+
+		load_index(serdes::log_index_path(path).c_str());
+
+		uint64_t record_no = index.empty() ? 0 : std::get<0>(index.back());
+		uint64_t offset = index.empty() ? 0 : std::get<1>(index.back());
+		const buf_t* base = (const buf_t*)file.data();
+		for (iterator it(base + offset, base + file.size()), last(base + file.size(), base + file.size());
+			it != last; ++it, record_no++) {
+			offset = (uint64_t)(it->frame - base);
+			if (record_no % index_interval == 0 && (index.empty() || std::get<0>(index.back()) < record_no))
+				index.emplace_back(record_no, offset);
+			offset += it->size;
+		}
+		records = record_no;
+		valid_size = (size_t)offset;
+		return true;
+	}
+
+	inline uint64_t size() const { return records; }
+	inline size_t bytes() const { return valid_size; }
+	inline const std::vector<serdes::log_index_entry>& index_entries() const { return index; }
+
+	inline iterator begin() const { return iterator(data(), data() + valid_size); }
+	inline iterator end() const { return iterator(data() + valid_size, data() + valid_size); }
+
+	// Binary search of the sparse index, then at most index_interval frames are skipped.
+	inline iterator seek(uint64_t record_no) const {
+		if (record_no >= records)
+			return end();
+		auto entry = std::upper_bound(index.begin(), index.end(), record_no,
+			[](uint64_t no, const serdes::log_index_entry& e) { return no < std::get<0>(e); });
+		uint64_t current = 0;
+		size_t offset = 0;
+		if (entry != index.begin()) {
+			--entry;
+			current = std::get<0>(*entry);
+			offset = (size_t)std::get<1>(*entry);
+		}
+		iterator it(data() + offset, data() + valid_size);
+		for (; current < record_no; current++)
+			++it;
+		return it;
+	}
+
+private:
+	inline const buf_t* data() const { return (const buf_t*)file.data(); }
+
+	// Entries beyond the mapped log (index written ahead of a torn log) are ignored.
+	inline void load_index(const char* index_path) {
+		MappedFile index_file;
+		if (!index_file.open(index_path))
+			return;
+		const size_t entries = index_file.size() / serdes::log_index_entry_size;
+		index.reserve(entries);
+		for (size_t i = 0; i < entries; i++) {
+			serdes::log_index_entry entry;
+			SerDes<buf_t, big_endian>::deserialize(entry,
+				(const buf_t*)index_file.data() + i * serdes::log_index_entry_size);
+			if (std::get<1>(entry) >= file.size() ||
+				(!index.empty() && std::get<0>(entry) <= std::get<0>(index.back())))
+				break;
+			index.push_back(entry);
+		}
+	}
+
+	MappedFile file;
+	std::vector<serdes::log_index_entry> index;
+	uint64_t records = 0;
+	size_t valid_size = 0;
+};
+
+// Appends are batched in memory and written with a single write() per flush.
+// commit() flushes and fdatasync()s once for the whole batch (group commit).
+// A write that fails part way is truncated away and its batch kept, so the next flush() writes
+// it again at the same offset. When the truncation fails too, the writer fails every later call.
+template<typename buf_t = uint8_t, bool big_endian = false>
+class RecordLogWriter {
+public:
+	explicit RecordLogWriter(size_t batch_bytes = 64 * 1024)
+		: flush_threshold(batch_bytes) {}
+
+	RecordLogWriter(const RecordLogWriter&) = delete;
+	RecordLogWriter& operator=(const RecordLogWriter&) = delete;
+
+	~RecordLogWriter() {
+		close();
+	}
+
+	// Opens or creates a log. Existing records are counted through the index and a torn tail is truncated.
+	// An interval of 0 is rejected.
+	inline bool open(const char* path, uint64_t interval = serdes::default_index_interval) {
+		close();
+		if (interval == 0)
+			return false;
+		index_interval = interval;
+		{
+			RecordLogReader<buf_t, big_endian> reader;
+			if (reader.open(path, interval)) {
+				records = reader.size();
+				file_size = reader.bytes();
+				// the index is rewritten from the validated entries
+				for (auto& entry : reader.index_entries()) {
+					const size_t pos = index_batch.size();
+					index_batch.resize(pos + serdes::log_index_entry_size);
+					SerDes<buf_t, big_endian>::serialize(index_batch.data() + pos, entry);
+				}
+			}
+		}
+		fd = ::open(path, O_WRONLY | O_CREAT, 0644);
+		index_fd = ::open(serdes::log_index_path(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0 || index_fd < 0 || ::ftruncate(fd, (off_t)file_size) != 0 ||
+			::lseek(fd, (off_t)file_size, SEEK_SET) < 0 || !flush()) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	// Returns the frame size, or 0 when the writer is closed or failed, or when the automatic
+	// flush failed : the record then stays in the batch, for the next flush() or commit().
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline size_t append(Args&&... args) {
+		if (fd < 0 || failed)
+			return 0;
+		const size_t offset = batch.size();
+		const size_t size = dyn_serdes.template append_command<class_id, func_id>(batch, std::forward<Args>(args)...);
+		return on_append(offset) ? size : 0;
+	}
+
+	// Appends an already built frame
+	inline size_t append_frame(const buf_t* frame, size_t size) {
+		if (fd < 0 || failed)
+			return 0;
+		const size_t offset = batch.size();
+		batch.insert(batch.end(), frame, frame + size);
+		return on_append(offset) ? size : 0;
+	}
+
+	inline bool flush() {
+		if (fd < 0 || failed)
+			return false;
+		if (!batch.empty()) {
+			if (!write_batch(fd, batch, file_size))
+				return false;
+			file_size += batch.size();
+			batch.clear();
+		}
+		if (!index_batch.empty()) {
+			if (!write_batch(index_fd, index_batch, index_size))
+				return false;
+			index_size += index_batch.size();
+			index_batch.clear();
+		}
+		return true;
+	}
+
+	inline bool commit() {
+		return flush() && ::fdatasync(fd) == 0 && ::fdatasync(index_fd) == 0;
+	}
+
+	inline void close() {
+		if (fd >= 0)
+			commit();
+		if (fd >= 0)
+			::close(fd);
+		if (index_fd >= 0)
+			::close(index_fd);
+		fd = index_fd = -1;
+		failed = false;
+		records = 0;
+		file_size = 0;
+		index_size = 0;
+		batch.clear();
+		index_batch.clear();
+	}
+
+	// Compression and other frame options
+	inline DynamicSerDes<buf_t, big_endian>& command_serdes() { return dyn_serdes; }
+
+	inline uint64_t size() const { return records; }
+
+	// A partial write could not be truncated, the files are left as they are.
+	inline bool is_failed() const { return failed; }
+
+private:
+	// Writes 'data' at 'offset' (the file size), a partial write is truncated back to 'offset'.
+	inline bool write_batch(int file, const std::vector<buf_t>& data, size_t offset) {
+		size_t written;
+		if (serdes::write_all(file, data.data(), data.size(), written))
+			return true;
+		if (written != 0 && (::ftruncate(file, (off_t)offset) != 0 || ::lseek(file, (off_t)offset, SEEK_SET) < 0))
+			failed = true;
+		return false;
+	}
+
+	inline bool on_append(size_t batch_offset) {
+		if (records % index_interval == 0) {
+			const size_t pos = index_batch.size();
+			index_batch.resize(pos + serdes::log_index_entry_size);
+			SerDes<buf_t, big_endian>::serialize(index_batch.data() + pos,
+				serdes::log_index_entry(records, (uint64_t)(file_size + batch_offset)));
+		}
+		records++;
+		return batch.size() < flush_threshold || flush();
+	}
+
+	const size_t flush_threshold;
+	uint64_t index_interval = serdes::default_index_interval;
+	int fd = -1;
+	int index_fd = -1;
+	bool failed = false;
+	uint64_t records = 0;
+	size_t file_size = 0;
+	size_t index_size = 0;
+	std::vector<buf_t> batch;
+	std::vector<buf_t> index_batch;
+	DynamicSerDes<buf_t, big_endian> dyn_serdes;
+};
+
+#endif // !__SERDES_RECORD_LOG_HPP__
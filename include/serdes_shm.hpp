@@ -0,0 +1,220 @@
+#pragma once
+#ifndef __SERDES_SHM_HPP__
+#define __SERDES_SHM_HPP__
+
+#include "serializer_deserializer.hpp"
+#include "serdes_queue.hpp"
+#include <chrono>
+#include <thread>
+#include <cerrno>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif // !__linux__
+
+//--------------------------------------------------------------------------------------------------
+// Shared memory transport (POSIX)
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+
+	// Segment layout : shm_control + ring_control + ring bytes
+	struct shm_control {
+		uint32_t magic;
+		uint32_t reserved;
+		uint64_t capacity;
+		alignas(cache_line_size) std::atomic<uint32_t> wake_seq; // futex word
+		std::atomic<uint32_t> waiting;
+	};
+
+	static constexpr uint32_t shm_magic = 0x53444D51; // "SDMQ"
+
+	// Blocks while *word == expected, at most timeout_ms (negative : no timeout)
+	inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected, int timeout_ms) {
+#ifdef __linux__
+		struct timespec ts;
+		ts.tv_sec = timeout_ms / 1000;
+		ts.tv_nsec = (long)(timeout_ms % 1000) * 1000000L;
+		syscall(SYS_futex, static_cast<void*>(&word), FUTEX_WAIT, expected, timeout_ms < 0 ? nullptr : &ts, nullptr, 0);
+#else
+		UNUSED(expected);
+		std::this_thread::sleep_for(std::chrono::microseconds(timeout_ms < 0 || timeout_ms > 1 ? 1000 : 50));
+#endif
+	}
+
+	inline void futex_wake(std::atomic<uint32_t>& word) {
+#ifdef __linux__
+		syscall(SYS_futex, static_cast<void*>(&word), FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#else
+		UNUSED(word);
+#endif
+	}
+
+} // namespace serdes
+
+// Cross-process channel over a named POSIX shared memory segment holding a MessageRing.
+// Producers serialize straight into the shared pages with the same frames as DynamicSerDes,
+// the consumer decodes in place. A consumer blocked in wait() sleeps on a futex and is only
+// woken (one syscall) when it announced itself as waiting, otherwise sends make no syscall.
+template<bool multi_producer = false, typename buf_t = uint8_t, bool big_endian = false>
+class SharedMemoryChannel {
+public:
+	typedef MessageRing<multi_producer, buf_t, big_endian> ring_type;
+
+	SharedMemoryChannel() = default;
+	SharedMemoryChannel(const SharedMemoryChannel&) = delete;
+	SharedMemoryChannel& operator=(const SharedMemoryChannel&) = delete;
+
+	~SharedMemoryChannel() {
+		close();
+	}
+
+	// Creates the segment ('name' as for shm_open, e.g. "/my_channel"), capacity is a power of two.
+	inline bool create(const char* name, size_t capacity) {
+		close();
+		const int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+		if (fd < 0)
+			return false;
+		const size_t size = segment_size(capacity);
+		const bool ok = ::ftruncate(fd, (off_t)size) == 0 && map(fd, size);
+		::close(fd);
+		if (!ok) {
+			::shm_unlink(name);
+			return false;
+		}
+		new (&control->wake_seq) std::atomic<uint32_t>(0);
+		new (&control->waiting) std::atomic<uint32_t>(0);
+		control->capacity = capacity;
+		ring_view.reset(new ring_type(ring_memory(), capacity, true));
+		std::atomic_thread_fence(std::memory_order_release);
+		control->magic = serdes::shm_magic; // attachable from now on
+		return true;
+	}
+
+	// Attaches to a segment made by create(). Returns false if it does not exist or is not ready yet.
+	inline bool open(const char* name) {
+		close();
+		const int fd = ::shm_open(name, O_RDWR, 0600);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		const bool ok = ::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(serdes::shm_control) &&
+			map(fd, (size_t)st.st_size);
+		::close(fd);
+		if (!ok)
+			return false;
+		if (control->magic != serdes::shm_magic || segment_size(control->capacity) != mapped_size) {
+			close();
+			return false;
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		ring_view.reset(new ring_type(ring_memory(), (size_t)control->capacity, false));
+		return true;
+	}
+
+	inline void close() {
+		ring_view.reset();
+		if (control)
+			::munmap(control, mapped_size);
+		control = nullptr;
+		mapped_size = 0;
+	}
+
+	static inline bool unlink(const char* name) {
+		return ::shm_unlink(name) == 0;
+	}
+
+	inline ring_type& ring() { return *ring_view; }
+
+	//----------------------------------------------------------------------------------------------
+	// Producer side
+	//----------------------------------------------------------------------------------------------
+
+	template<typename Tp>
+	inline serdes::push_result try_send(const Tp& src) {
+		const serdes::push_result result = ring_view->try_push(src);
+		if (result == serdes::push_result::pushed)
+			notify();
+		return result;
+	}
+
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline serdes::push_result try_send_command(const Args&... args) {
+		const serdes::push_result result = ring_view->template try_push_command<class_id, func_id>(args...);
+		if (result == serdes::push_result::pushed)
+			notify();
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------------------
+	// Consumer side
+	//----------------------------------------------------------------------------------------------
+
+	// Waits until a message is available. Returns false on timeout (negative : no timeout).
+	// Wakeups are not exact (a late notify of an already consumed message), so the ring is rechecked.
+	inline bool wait(int timeout_ms = -1) {
+		size_t size;
+		if (ring_view->front(size))
+			return true;
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms < 0 ? 0 : timeout_ms);
+		for (;;) {
+			int remaining = -1;
+			if (timeout_ms >= 0) {
+				const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+				if (left.count() <= 0)
+					return false;
+				remaining = (int)left.count();
+			}
+			const uint32_t seq = control->wake_seq.load(std::memory_order_acquire);
+			control->waiting.store(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (!ring_view->front(size))
+				serdes::futex_wait(control->wake_seq, seq, remaining);
+			control->waiting.store(0, std::memory_order_relaxed);
+			if (ring_view->front(size))
+				return true;
+		}
+	}
+
+	template<typename Tp>
+	inline bool receive(Tp& dst, int timeout_ms = -1) {
+		return wait(timeout_ms) && ring_view->try_pop(dst);
+	}
+
+private:
+	static inline size_t segment_size(size_t capacity) {
+		return sizeof(serdes::shm_control) + ring_type::memory_size(capacity);
+	}
+
+	inline void* ring_memory() {
+		return static_cast<uint8_t*>(static_cast<void*>(control)) + sizeof(serdes::shm_control);
+	}
+
+	inline bool map(int fd, size_t size) {
+		void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (addr == MAP_FAILED)
+			return false;
+		control = static_cast<serdes::shm_control*>(addr);
+		mapped_size = size;
+		return true;
+	}
+
+	inline void notify() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (control->waiting.load(std::memory_order_relaxed)) {
+			control->wake_seq.fetch_add(1, std::memory_order_release);
+			serdes::futex_wake(control->wake_seq);
+		}
+	}
+
+	serdes::shm_control* control = nullptr;
+	size_t mapped_size = 0;
+	std::unique_ptr<ring_type> ring_view;
+};
+
+#endif // !__SERDES_SHM_HPP__
@@ -0,0 +1,227 @@
+#pragma once
+#ifndef __SERDES_STATS_HPP__
+#define __SERDES_STATS_HPP__
+
+#include "serializer_deserializer.hpp"
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+//--------------------------------------------------------------------------------------------------
+// Per-thread statistics
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+
+	static constexpr size_t latency_buckets = 32; // bucket i : elapsed < 2^i ns, the last one takes the rest
+
+	struct stats_entry {
+		std::string type;  // top-level type name
+		uint32_t command;  // command_key(class_id, func_id), no_command for SerDes calls
+		bool decode;
+		uint64_t count;
+		uint64_t bytes;
+		uint64_t total_ns;
+		uint64_t allocations;
+		std::array<uint64_t, latency_buckets> latency;
+
+		inline uint16_t class_id() const { return (uint16_t)(command >> 16); }
+		inline uint16_t func_id() const { return (uint16_t)command; }
+
+		// Upper bound of the latency bucket holding the 'percent' percentile, in ns
+		inline uint64_t latency_percentile(double percent) const {
+			const uint64_t rank = (uint64_t)((double)count * percent / 100.0);
+			uint64_t seen = 0;
+			for (size_t i = 0; i < latency_buckets; i++) {
+				seen += latency[i];
+				if (seen > rank)
+					return (uint64_t)1 << i;
+			}
+			return (uint64_t)1 << (latency_buckets - 1);
+		}
+	};
+
+	// Statistics policy counting per thread, without locks or atomic read-modify-write on the hot path.
+	// Every thread owns its counters (single writer, relaxed stores) and snapshot() merges
+	// the live threads with the totals of the exited ones.
+	//   DynamicSerDes<uint8_t, false, serdes::thread_stats> dyn_serdes;
+	//   InstrumentedSerDes<serdes::thread_stats>::serialize(ptr, value);
+	class thread_stats {
+	public:
+		static constexpr bool enabled = true;
+
+		static inline uint64_t now() {
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now().time_since_epoch()).count();
+		}
+
+		template<typename Tp>
+		static inline void on_encode(uint32_t command, size_t bytes, uint64_t ns, size_t allocations) {
+			record(type_id<Tp>(), command, false, bytes, ns, allocations);
+		}
+
+		template<typename Tp>
+		static inline void on_decode(uint32_t command, size_t bytes, uint64_t ns, size_t allocations) {
+			record(type_id<Tp>(), command, true, bytes, ns, allocations);
+		}
+
+		// Totals of all threads since the start of the process, ordered by type, direction and command.
+		static inline std::vector<serdes::stats_entry> snapshot() {
+			registry& reg = instance();
+			std::lock_guard<std::mutex> guard(reg.lock);
+			std::map<uint64_t, totals> merged(reg.retired);
+			for (table* tab : reg.tables) {
+				std::lock_guard<std::mutex> table_guard(tab->lock);
+				for (auto& entry : tab->entries)
+					merged[entry.first].add(*entry.second);
+			}
+			std::vector<serdes::stats_entry> entries;
+			entries.reserve(merged.size());
+			for (auto& entry : merged) {
+				const totals& sum = entry.second;
+				entries.push_back(serdes::stats_entry{ reg.type_names[(size_t)(entry.first >> 33)],
+					(uint32_t)entry.first, ((entry.first >> 32) & 1) != 0,
+					sum.count, sum.bytes, sum.total_ns, sum.allocations, sum.latency });
+			}
+			return entries;
+		}
+
+		// One line per entry : type, command, direction, count, bytes, average / p99 latency, allocations
+		static inline std::string report(const std::vector<serdes::stats_entry>& entries) {
+			std::string text;
+			char line[128];
+			for (auto& entry : entries) {
+				if (entry.command == serdes::no_command)
+					snprintf(line, sizeof(line), "%s [-] ", entry.decode ? "decode" : "encode");
+				else
+					snprintf(line, sizeof(line), "%s [%u:%u] ", entry.decode ? "decode" : "encode",
+						(unsigned)entry.class_id(), (unsigned)entry.func_id());
+				text += line;
+				text += entry.type;
+				snprintf(line, sizeof(line), " : count %" PRIu64 ", bytes %" PRIu64 ", avg %" PRIu64 " ns, p99 < %" PRIu64 " ns, allocations %" PRIu64 "\n",
+					entry.count, entry.bytes, entry.count ? entry.total_ns / entry.count : 0,
+					entry.latency_percentile(99.0), entry.allocations);
+				text += line;
+			}
+			return text;
+		}
+
+	private:
+		struct counters {
+			std::atomic<uint64_t> count{ 0 };
+			std::atomic<uint64_t> bytes{ 0 };
+			std::atomic<uint64_t> total_ns{ 0 };
+			std::atomic<uint64_t> allocations{ 0 };
+			std::array<std::atomic<uint64_t>, serdes::latency_buckets> latency{};
+		};
+
+		struct totals {
+			uint64_t count = 0;
+			uint64_t bytes = 0;
+			uint64_t total_ns = 0;
+			uint64_t allocations = 0;
+			std::array<uint64_t, serdes::latency_buckets> latency{};
+
+			inline void add(const counters& c) {
+				count += c.count.load(std::memory_order_relaxed);
+				bytes += c.bytes.load(std::memory_order_relaxed);
+				total_ns += c.total_ns.load(std::memory_order_relaxed);
+				allocations += c.allocations.load(std::memory_order_relaxed);
+				for (size_t i = 0; i < serdes::latency_buckets; i++)
+					latency[i] += c.latency[i].load(std::memory_order_relaxed);
+			}
+		};
+
+		// Counters of one thread. The owner looks up without the lock, which is only taken
+		// to insert a new key (rare) and by the readers.
+		struct table {
+			std::mutex lock;
+			std::unordered_map<uint64_t, std::unique_ptr<counters>> entries;
+		};
+
+		struct registry {
+			std::mutex lock;
+			std::vector<table*> tables;
+			std::map<uint64_t, totals> retired; // exited threads
+			std::vector<std::string> type_names;
+		};
+
+		// Registers the thread table, merges it into the retired totals at thread exit.
+		struct table_owner {
+			table tab;
+
+			table_owner() {
+				registry& reg = instance();
+				std::lock_guard<std::mutex> guard(reg.lock);
+				reg.tables.push_back(&tab);
+			}
+
+			~table_owner() {
+				registry& reg = instance();
+				std::lock_guard<std::mutex> guard(reg.lock);
+				for (auto& entry : tab.entries)
+					reg.retired[entry.first].add(*entry.second);
+				reg.tables.erase(std::find(reg.tables.begin(), reg.tables.end(), &tab));
+			}
+		};
+
+		static inline registry& instance() {
+			static registry reg;
+			return reg;
+		}
+
+		static inline table& local() {
+			static thread_local table_owner owner;
+			return owner.tab;
+		}
+
+		template<typename Tp>
+		static inline uint32_t type_id() {
+			static const uint32_t id = add_type(SerDes<>::type_name<Tp>());
+			return id;
+		}
+
+		static inline uint32_t add_type(std::string name) {
+			registry& reg = instance();
+			std::lock_guard<std::mutex> guard(reg.lock);
+			reg.type_names.push_back(std::move(name));
+			return (uint32_t)(reg.type_names.size() - 1);
+		}
+
+		static inline size_t bucket(uint64_t ns) {
+			size_t idx = 0;
+			while (idx + 1 < serdes::latency_buckets && (ns >> idx) != 0)
+				idx++;
+			return idx;
+		}
+
+		// single writer : a relaxed load + store instead of a locked add
+		static inline void add(std::atomic<uint64_t>& counter, uint64_t value) {
+			counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+		}
+
+		static inline void record(uint32_t type, uint32_t command, bool decode, size_t bytes, uint64_t ns, size_t allocations) {
+			table& tab = local();
+			const uint64_t key = ((uint64_t)type << 33) | ((uint64_t)decode << 32) | command;
+			auto it = tab.entries.find(key);
+			counters* c;
+			if (it != tab.entries.end())
+				c = it->second.get();
+			else {
+				std::lock_guard<std::mutex> guard(tab.lock);
+				c = tab.entries.emplace(key, std::unique_ptr<counters>(new counters())).first->second.get();
+			}
+			add(c->count, 1);
+			add(c->bytes, bytes);
+			add(c->total_ns, ns);
+			add(c->allocations, allocations);
+			add(c->latency[bucket(ns)], 1);
+		}
+	};
+
+} // namespace serdes
+
+#endif // !__SERDES_STATS_HPP__
@@ -2,16 +2,42 @@
 #ifndef __SERIALIZER_DESERIALIZER_HPP__
 #define __SERIALIZER_DESERIALIZER_HPP__
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <map>
 #include <vector>
 #include <array>
+#include <bitset>
 #include <tuple>
+#include <unordered_map>
 #include <type_traits>
+#include <typeindex>
+#include <memory>
 #include <string>
 #include <typeinfo>
 #ifdef __GNUC__
 #include <cxxabi.h>
 #endif // !__GNUC__
+#include <clocale>
+#if __cplusplus >= 201703L
+#include <optional>
+#include <variant>
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+#endif
+#if __cplusplus > 201703L && defined(__has_include)
+#if __has_include(<bit>)
+#include <bit>
+#endif
+#endif
 
 namespace serdes {
 
@@ -21,8 +47,9 @@ namespace serdes {
 	// Type traits
 	// ---------------------------
 
-	// Dynamic container
+	// Dynamic sequence container (vector, string, deque, list)
 	// http://stackoverflow.com/questions/12042824/how-to-write-a-type-trait-is-container-or-is-vector
+	// Elements must be addressable, which leaves out std::vector<bool>.
 	template<typename T, typename _ = void>
 	struct is_container : std::false_type {};
 
@@ -41,7 +68,8 @@ namespace serdes {
 		typename T::iterator,
 		typename T::const_iterator,
 		decltype(std::declval<T>().size()),
-		decltype(std::declval<T>().data()),
+		decltype(std::declval<T>().resize(0)),
+		decltype(&*std::declval<T>().begin()),
 		decltype(std::declval<T>().begin()),
 		decltype(std::declval<T>().end()),
 		decltype(std::declval<T>().cbegin()),
@@ -58,6 +86,67 @@ namespace serdes {
 	static_assert(is_container_v<std::string>, "");
 	static_assert(!is_container_v<std::array<float, 4>>, "");
 	static_assert(!is_container_v<float>, "");
+	static_assert(!is_container_v<std::vector<bool>>, "");
+
+	// Associative container (map, set, unordered_map, unordered_set and multi versions)
+	template<typename T, typename _ = void>
+	struct is_associative : std::false_type {};
+
+	template<typename T>
+	struct is_associative<
+		T,
+		std::conditional_t<
+		false,
+		is_container_helper<
+		typename T::key_type,
+		typename T::value_type,
+		typename T::allocator_type,
+		typename T::const_iterator,
+		decltype(std::declval<T>().size()),
+		decltype(std::declval<T>().begin()),
+		decltype(std::declval<T>().end()),
+		decltype(std::declval<T>().emplace_hint(std::declval<T>().cend(), std::declval<typename T::value_type>()))
+		>,
+		void
+		>
+	> : public std::true_type{};
+
+	template<typename T>
+	static constexpr bool is_associative_v = is_associative<T>::value;
+
+	static_assert(!is_associative_v<std::vector<float>>, "");
+	static_assert(!is_associative_v<float>, "");
+
+	// map-like associative container
+	template<typename T, typename _ = void>
+	struct has_mapped_type : std::false_type {};
+
+	template<typename T>
+	struct has_mapped_type<T, std::conditional_t<false, typename T::mapped_type, void>> : std::true_type {};
+
+	// reserve() (vector, unordered containers)
+	template<typename T, typename _ = void>
+	struct has_reserve : std::false_type {};
+
+	template<typename T>
+	struct has_reserve<T, std::conditional_t<false, decltype(std::declval<T&>().reserve(0)), void>> : std::true_type {};
+
+	// std::optional, std::variant (C++17)
+	template <typename T>
+	struct is_std_optional : std::false_type {};
+	template <typename T>
+	struct is_std_variant : std::false_type {};
+#if __cplusplus >= 201703L
+	template <typename T>
+	struct is_std_optional<std::optional<T>> : std::true_type {};
+	template <typename... Ts>
+	struct is_std_variant<std::variant<Ts...>> : std::true_type {};
+#endif
+
+	template<typename T>
+	static constexpr bool is_std_optional_v = is_std_optional<T>::value;
+	template<typename T>
+	static constexpr bool is_std_variant_v = is_std_variant<T>::value;
 
 	// Scalar
 	template<typename T>
@@ -108,6 +197,333 @@ namespace serdes {
 	static_assert(is_c_string_v<const char*>, "");
 	static_assert(!is_c_string_v<std::string>, "");
 
+	// std::vector<bool>, encoded bit-packed
+	template <typename T>
+	struct is_bit_vector : std::false_type {};
+	template <typename A>
+	struct is_bit_vector<std::vector<bool, A>> : std::true_type {};
+
+	template<typename T>
+	static constexpr bool is_bit_vector_v = is_bit_vector<T>::value;
+
+	static_assert(is_bit_vector_v<std::vector<bool>>, "");
+	static_assert(!is_bit_vector_v<std::vector<uint8_t>>, "");
+
+	// Elements of a container read in place from an aligned layout (SerDes::deserialize_aligned)
+	template<typename T>
+	struct array_view {
+		const T* ptr = nullptr;
+		size_t count = 0;
+
+		inline const T* data() const { return ptr; }
+		inline size_t size() const { return count; }
+		inline bool empty() const { return count == 0; }
+		inline const T* begin() const { return ptr; }
+		inline const T* end() const { return ptr + count; }
+		inline const T& operator[](size_t idx) const { return ptr[idx]; }
+	};
+
+	// Fixed size block (std::array, structure) read in place from an aligned layout
+	template<typename T>
+	struct block_view {
+		const T* ptr = nullptr;
+
+		inline const T& operator*() const { return *ptr; }
+		inline const T* operator->() const { return ptr; }
+	};
+
+	template<typename T>
+	struct is_wire_view : std::false_type {};
+	template<typename T>
+	struct is_wire_view<array_view<T>> : std::true_type {};
+	template<typename T>
+	struct is_wire_view<block_view<T>> : std::true_type {};
+
+	template<typename T>
+	static constexpr bool is_wire_view_v = is_wire_view<T>::value;
+
+	// Integer or enum taking 'width' bits in SerDes::serialize_packed, a plain T elsewhere
+	template<size_t width, typename T>
+	struct bits {
+		static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "bits of an integer or an enum");
+		static_assert(width > 0 && width <= sizeof(T) * 8, "bit width out of range");
+
+		T value;
+
+		constexpr bits() : value() {}
+		constexpr bits(T v) : value(v) {}
+		constexpr operator T() const { return value; }
+	};
+
+	// Width of the fields packed by SerDes::serialize_packed, 0 for the others
+	template<typename T>
+	struct bit_width : std::integral_constant<size_t, 0> {};
+	template<>
+	struct bit_width<bool> : std::integral_constant<size_t, 1> {};
+	template<size_t width, typename T>
+	struct bit_width<bits<width, T>> : std::integral_constant<size_t, width> {};
+	template<size_t N>
+	struct bit_width<std::bitset<N>> : std::integral_constant<size_t, N> {};
+
+	static_assert(bit_width<bits<5, uint8_t>>::value == 5, "");
+	static_assert(bit_width<float>::value == 0, "");
+
+	// Width of the tuple element 'idx', 0 past the end
+	template<class Tup, size_t idx, bool in_range = (idx < std::tuple_size<Tup>::value)>
+	struct tuple_bit_width : std::integral_constant<size_t, 0> {};
+	template<class Tup, size_t idx>
+	struct tuple_bit_width<Tup, idx, true> : bit_width<std::decay_t<std::tuple_element_t<idx, Tup>>> {};
+
+	// Bits and number of the packed fields starting at 'idx'
+	template<class Tup, size_t idx, size_t width = tuple_bit_width<Tup, idx>::value>
+	struct bit_run {
+		static constexpr size_t bits = width + bit_run<Tup, idx + 1>::bits;
+		static constexpr size_t fields = 1 + bit_run<Tup, idx + 1>::fields;
+	};
+	template<class Tup, size_t idx>
+	struct bit_run<Tup, idx, 0> {
+		static constexpr size_t bits = 0;
+		static constexpr size_t fields = 0;
+	};
+
+	static_assert(bit_run<std::tuple<bool, bits<3, uint8_t>, float, bool>, 0>::bits == 4, "");
+	static_assert(bit_run<std::tuple<bool, bits<3, uint8_t>, float, bool>, 0>::fields == 2, "");
+
+} // namespace serdes
+
+//--------------------------------------------------------------------------------------------------
+// String dictionary
+//--------------------------------------------------------------------------------------------------
+
+// Strings of a stream numbered in first-seen order, for SerDes::serialize_interned.
+// The sender looks strings up by value, the receiver by number, each side owns an instance
+// and both stop adding entries at the same 'max_entries'.
+class StringDictionary {
+public:
+	static constexpr uint32_t npos = 0xFFFFFFFF;
+
+	explicit StringDictionary(size_t max_entries = 1 << 16) : limit(max_entries) {}
+
+	// Sender side
+	inline uint32_t find(const std::string& str) const {
+		const auto it = ids.find(str);
+		return it == ids.end() ? npos : it->second;
+	}
+
+	inline void insert(const std::string& str) {
+		if (entries < limit)
+			ids.emplace(str, (uint32_t)entries++);
+	}
+
+	// Receiver side
+	inline const std::string* at(uint64_t id) const {
+		return id < strings.size() ? &strings[(size_t)id] : nullptr;
+	}
+
+	inline void append(const std::string& str) {
+		if (entries < limit) {
+			strings.push_back(str);
+			entries++;
+		}
+	}
+
+	inline size_t size() const { return entries; }
+
+	inline void clear() {
+		ids.clear();
+		strings.clear();
+		entries = 0;
+	}
+
+private:
+	std::unordered_map<std::string, uint32_t> ids;
+	std::vector<std::string> strings;
+	size_t entries = 0;
+	size_t limit;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Decode recycler
+//--------------------------------------------------------------------------------------------------
+
+// Spare elements for SerDes::deserialize_recycled, one pool per element type.
+// Elements dropped when a decoded container shrinks are kept here with their buffers
+// and swapped back when a container grows, so a reused destination stops allocating.
+class DecodeRecycler {
+public:
+	explicit DecodeRecycler(size_t max_spares_per_type = 1024) : limit(max_spares_per_type) {}
+
+	// Pools are only looked up when a container changes size.
+	template<typename Tp>
+	inline std::vector<Tp>& spares() {
+		std::shared_ptr<void>& pool = pools[std::type_index(typeid(Tp))];
+		if (!pool)
+			pool = std::make_shared<std::vector<Tp>>();
+		return *static_cast<std::vector<Tp>*>(pool.get());
+	}
+
+	inline size_t max_spares() const { return limit; }
+
+	inline void clear() {
+		pools.clear();
+	}
+
+private:
+	std::unordered_map<std::type_index, std::shared_ptr<void>> pools;
+	size_t limit;
+};
+
+//--------------------------------------------------------------------------------------------------
+// Text formatting
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+
+	// Appends the decimal digits of 'value', two digits per division.
+	template<typename Tp>
+	inline std::enable_if_t<std::is_unsigned<Tp>::value> append_integer(std::string& out, Tp value) {
+		static constexpr char digit_pairs[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		char buf[24];
+		char* const end = buf + sizeof(buf);
+		char* pos = end;
+		uint64_t rest = value;
+		while (rest >= 100) {
+			const size_t idx = (size_t)(rest % 100) * 2;
+			rest /= 100;
+			*--pos = digit_pairs[idx + 1];
+			*--pos = digit_pairs[idx];
+		}
+		if (rest >= 10) {
+			*--pos = digit_pairs[rest * 2 + 1];
+			*--pos = digit_pairs[rest * 2];
+		}
+		else
+			*--pos = (char)('0' + rest);
+		out.append(pos, end);
+	}
+
+	template<typename Tp>
+	inline std::enable_if_t<std::is_signed<Tp>::value> append_integer(std::string& out, Tp value) {
+		if (value < 0) {
+			out += '-';
+			append_integer(out, (uint64_t)0 - (uint64_t)value);
+		}
+		else
+			append_integer(out, (uint64_t)value);
+	}
+
+#if !(defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L)
+	inline int print_float(char* buf, size_t size, int precision, double value) {
+		return snprintf(buf, size, "%.*g", precision, value);
+	}
+
+	inline int print_float(char* buf, size_t size, int precision, long double value) {
+		return snprintf(buf, size, "%.*Lg", precision, value);
+	}
+
+	// Read back as the target type, a float is not rounded twice through double
+	inline float parse_float(const char* str, float, char** end = nullptr) { return strtof(str, end); }
+	inline double parse_float(const char* str, double, char** end = nullptr) { return strtod(str, end); }
+	inline long double parse_float(const char* str, long double, char** end = nullptr) { return strtold(str, end); }
+
+	// snprintf output with the decimal point of LC_NUMERIC written as '.'
+	inline void append_c_number(std::string& out, const char* buf, size_t len) {
+		const char* const point = localeconv()->decimal_point;
+		const size_t point_len = strlen(point);
+		const char* const end = buf + len;
+		const char* found = point_len == 0 || (point_len == 1 && point[0] == '.') ? end : std::search(buf, end, point, point + point_len);
+		out.append(buf, found);
+		if (found != end) {
+			out += '.';
+			out.append(found + point_len, end);
+		}
+	}
+#endif
+
+	// Decimal form that reads back to the same value, independent of the C locale.
+	// With std::to_chars it is the shortest one. Otherwise digits10 digits when they read back,
+	// else max_digits10 : snprintf and strto* share LC_NUMERIC, only the decimal point is rewritten.
+	// Not finite values are nan / inf, or null in JSON.
+	template<typename Tp>
+	inline void append_float(std::string& out, Tp value, bool json) {
+		if (value != value || value - value != value - value) {
+			out += json ? "null" : value != value ? "nan" : value < 0 ? "-inf" : "inf";
+			return;
+		}
+		char buf[48];
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+		const std::to_chars_result result = std::to_chars(buf, buf + sizeof(buf), value);
+		out.append(buf, result.ptr);
+#else
+		typedef std::conditional_t<std::is_same<Tp, long double>::value, long double, double> print_type;
+		int len = print_float(buf, sizeof(buf), std::numeric_limits<Tp>::digits10, (print_type)value);
+		if (parse_float(buf, value) != value)
+			len = print_float(buf, sizeof(buf), std::numeric_limits<Tp>::max_digits10, (print_type)value);
+		append_c_number(out, buf, (size_t)len);
+#endif
+	}
+
+	// Parses the whole of 'str' as a decimal number ('.' point, no leading '+') of the target type,
+	// independent of the C locale : std::from_chars when available, otherwise strto* of the type
+	// on a copy with the decimal point of LC_NUMERIC. False on syntax errors and overflow.
+	template<typename Tp>
+	inline bool parse_c_float(const char* str, size_t length, Tp& value) {
+		if (length == 0 || str[0] == '+')
+			return false;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+		const std::from_chars_result result = std::from_chars(str, str + length, value);
+		return result.ec == std::errc() && result.ptr == str + length;
+#else
+		char buf[128];
+		const char* const point = localeconv()->decimal_point;
+		const size_t point_len = strlen(point);
+		size_t pos = 0;
+		for (size_t i = 0; i < length; i++) {
+			const bool is_point = str[i] == '.' && point_len > 0;
+			const size_t bytes = is_point ? point_len : 1;
+			if (pos + bytes >= sizeof(buf))
+				return false;
+			memcpy(buf + pos, is_point ? point : str + i, bytes);
+			pos += bytes;
+		}
+		buf[pos] = '\0';
+		char* parse_end = nullptr;
+		value = parse_float(buf, value, &parse_end);
+		return parse_end == buf + pos && value - value == value - value;
+#endif
+	}
+
+	// JSON string literal, runs of plain characters are appended at once
+	inline void append_json_string(std::string& out, const char* str, size_t size) {
+		static constexpr char hex[] = "0123456789abcdef";
+		out += '"';
+		size_t plain = 0;
+		for (size_t i = 0; i < size; i++) {
+			const unsigned char ch = (unsigned char)str[i];
+			if (ch >= 0x20 && ch != '"' && ch != '\\')
+				continue;
+			out.append(str + plain, i - plain);
+			plain = i + 1;
+			switch (ch) {
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			case '\b': out += "\\b"; break;
+			case '\f': out += "\\f"; break;
+			default:
+				const char escape[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xF] };
+				out.append(escape, sizeof(escape));
+			}
+		}
+		out.append(str + plain, size - plain);
+		out += '"';
+	}
+
 } // namespace serdes
 
 //--------------------------------------------------------------------------------------------------
@@ -120,9 +536,36 @@ private:
 	template<typename Tp>
 	static constexpr bool is_serdes_special = (
 		serdes::is_container_v<Tp> ||
+		serdes::is_bit_vector_v<Tp> ||
 		serdes::is_std_array_v<Tp> ||
 		serdes::is_std_tuple_v<Tp> ||
-		serdes::is_c_string_v<Tp>);
+		serdes::is_c_string_v<Tp> ||
+		serdes::is_associative_v<Tp> ||
+		serdes::is_std_optional_v<Tp> ||
+		serdes::is_std_variant_v<Tp>);
+
+	// Types written as by serialize() inside delta and interned encodings
+	template<typename Tp>
+	static constexpr bool is_encoded_whole = (
+		serdes::is_c_string_v<Tp> ||
+		serdes::is_bit_vector_v<Tp> ||
+		serdes::is_associative_v<Tp> ||
+		serdes::is_std_optional_v<Tp> ||
+		serdes::is_std_variant_v<Tp> ||
+		!is_serdes_special<Tp>);
+
+	// std::variant index of a valueless variant
+	static constexpr size_t variant_valueless = 0xFF;
+
+	// Special types encoded with a variable size of their own
+	template<typename Tp>
+	static constexpr bool is_variable_special = (
+		serdes::is_container_v<Tp> ||
+		serdes::is_bit_vector_v<Tp> ||
+		serdes::is_c_string_v<Tp> ||
+		serdes::is_associative_v<Tp> ||
+		serdes::is_std_optional_v<Tp> ||
+		serdes::is_std_variant_v<Tp>);
 
 public:
 
@@ -145,11 +588,44 @@ public:
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
+	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>> || serdes::is_bit_vector_v<std::decay_t<Tp>>,
 		bool> is_serdesable() {
 		return true;
 	}
 
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_associative_v<std::decay_t<Tp>>,
+		bool> is_serdesable() {
+		return is_entry_serdesable<std::decay_t<Tp>>();
+	}
+
+#if __cplusplus >= 201703L
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_optional_v<std::decay_t<Tp>>,
+		bool> is_serdesable() {
+		return is_serdesable<typename std::decay_t<Tp>::value_type>();
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_variant_v<std::decay_t<Tp>>,
+		bool> is_serdesable() {
+		return std::variant_size<std::decay_t<Tp>>::value < variant_valueless &&
+			is_variant_serdesable<std::decay_t<Tp>, 0>();
+	}
+
+	template<class Var, size_t idx>
+	static inline constexpr std::enable_if_t<!(idx < std::variant_size<Var>::value),
+		bool> is_variant_serdesable() {
+		return true;
+	}
+
+	template<class Var, size_t idx>
+	static inline constexpr std::enable_if_t<(idx < std::variant_size<Var>::value),
+		bool> is_variant_serdesable() {
+		return is_serdesable<std::variant_alternative_t<idx, Var>>() && is_variant_serdesable<Var, idx + 1>();
+	}
+#endif
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
 		bool> is_serdesable() {
@@ -174,9 +650,107 @@ public:
 		return ok && is_tuple_serdesable<Tup, idx + 1>();
 	}
 
+	// map entries are key + mapped value, set entries the key
+	template<class Tp>
+	static inline constexpr std::enable_if_t<serdes::has_mapped_type<Tp>::value,
+		bool> is_entry_serdesable() {
+		return is_serdesable<typename Tp::key_type>() && is_serdesable<typename Tp::mapped_type>();
+	}
+
+	template<class Tp>
+	static inline constexpr std::enable_if_t<!serdes::has_mapped_type<Tp>::value,
+		bool> is_entry_serdesable() {
+		return is_serdesable<typename Tp::key_type>();
+	}
+
 	template<typename Tp>
 	static constexpr bool is_serdesable_v = is_serdesable<Tp>();
 
+	// Encoded size known at compile time (no container, C string, optional or variant inside)
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<is_variable_special<std::decay_t<Tp>>,
+		bool> is_fixed_size() {
+		return false;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		bool> is_fixed_size() {
+		return is_fixed_size<typename std::decay_t<Tp>::value_type>();
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		bool> is_fixed_size() {
+		return tuple_is_fixed_size<std::decay_t<Tp>, 0>();
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
+		bool> is_fixed_size() {
+		return true;
+	}
+
+	template<class Tup, size_t idx>
+	static inline constexpr std::enable_if_t<
+		serdes::is_std_tuple_v<Tup> &&
+		!(idx < std::tuple_size<Tup>::value),
+		bool> tuple_is_fixed_size() {
+		return true;
+	}
+
+	template<class Tup, size_t idx>
+	static inline constexpr std::enable_if_t<
+		serdes::is_std_tuple_v<Tup> &&
+		(idx < std::tuple_size<Tup>::value),
+		bool> tuple_is_fixed_size() {
+		return is_fixed_size<typename std::tuple_element<idx, Tup>::type>() && tuple_is_fixed_size<Tup, idx + 1>();
+	}
+
+	template<typename Tp>
+	static constexpr bool is_fixed_size_v = is_fixed_size<Tp>();
+
+	// Encoded size of a fixed size type (0 for others)
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<is_variable_special<std::decay_t<Tp>>,
+		size_t> fixed_size() {
+		return (size_t)0;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		size_t> fixed_size() {
+		return fixed_size<typename std::decay_t<Tp>::value_type>() * std::tuple_size<std::decay_t<Tp>>::value;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		size_t> fixed_size() {
+		return is_fixed_size<Tp>() ? tuple_fixed_size<std::decay_t<Tp>, 0>() : (size_t)0;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
+		size_t> fixed_size() {
+		return sizeof(Tp);
+	}
+
+	template<class Tup, size_t idx>
+	static inline constexpr std::enable_if_t<
+		serdes::is_std_tuple_v<Tup> &&
+		!(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_fixed_size() {
+		return (size_t)0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline constexpr std::enable_if_t<
+		serdes::is_std_tuple_v<Tup> &&
+		(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_fixed_size() {
+		return fixed_size<typename std::tuple_element<idx, Tup>::type>() + tuple_fixed_size<Tup, idx + 1>();
+	}
+
 public:
 	typedef const buf_t* const __restrict deser_src;
 
@@ -206,17 +780,48 @@ public:
 		return dst.ret_tp;
 	}
 
+	// Element counts are uint32_t. Counts of large_count_marker or more are escaped
+	// with the marker followed by a uint64_t count.
+	static constexpr uint32_t large_count_marker = 0xFFFFFFFF;
+
+	static inline size_t extract_count(deser_src ptr, size_t& count) {
+		const uint32_t short_count = extract<uint32_t>(ptr);
+		if (short_count != large_count_marker) {
+			count = short_count;
+			return sizeof(uint32_t);
+		}
+		count = (size_t)extract<uint64_t>(ptr + sizeof(uint32_t));
+		return sizeof(uint32_t) + sizeof(uint64_t);
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
 		size_t>	deserialize(Tp& vec, deser_src ptr) {
-		auto elem_nums = extract<uint32_t>(ptr);
-		size_t cursor = sizeof(uint32_t);
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
 		vec.resize(elem_nums);
 		for (auto& elem : vec)
 			cursor += deserialize(elem, ptr + cursor);
 		return cursor;
 	}
 
+	// std::vector<bool> : count + bits, 8 per byte from the least significant
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_bit_vector_v<std::decay_t<Tp>>,
+		size_t>	deserialize(Tp& vec, deser_src ptr) {
+		size_t elem_nums = 0;
+		const size_t cursor = extract_count(ptr, elem_nums);
+		vec.resize(elem_nums);
+		auto it = vec.begin();
+		for (size_t i = 0; i < elem_nums; i += 8) {
+			const uint8_t byte = (uint8_t)ptr[cursor + i / 8];
+			const size_t nums = std::min<size_t>(8, elem_nums - i);
+			for (size_t bit = 0; bit < nums; bit++, ++it)
+				*it = ((byte >> bit) & 1) != 0;
+		}
+		return cursor + (elem_nums + 7) / 8;
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
 		size_t>	deserialize(Tp& arr, deser_src ptr) {
@@ -236,8 +841,8 @@ public:
 	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
 		size_t> deserialize(Tp& c_str, deser_src ptr) {
 		using raw_Tp = typename std::remove_pointer<Tp>::type;
-		auto elem_nums = extract<uint32_t>(ptr);
-		constexpr size_t cursor = sizeof(uint32_t);
+		size_t elem_nums = 0;
+		const size_t cursor = extract_count(ptr, elem_nums);
 		if (c_str) delete c_str;
 		c_str = new raw_Tp[elem_nums + 1];
 		memcpy(c_str, ptr + cursor, elem_nums);
@@ -245,9 +850,23 @@ public:
 		return cursor + elem_nums;
 	}
 
+	// Entries are inserted at the end hint, which is O(1) for sorted input,
+	// unordered containers reserve their buckets first.
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
-		size_t> deserialize(Tp& dst, deser_src ptr) {
+	static inline constexpr std::enable_if_t<serdes::is_associative_v<std::decay_t<Tp>>,
+		size_t> deserialize(Tp& assoc, deser_src ptr) {
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
+		assoc.clear();
+		reserve_entries(assoc, elem_nums);
+		for (size_t i = 0; i < elem_nums; i++)
+			cursor += deserialize_entry(assoc, ptr + cursor);
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
+		size_t> deserialize(Tp& dst, deser_src ptr) {
 		dst = extract<Tp>(ptr);
 		return sizeof(Tp);
 	}
@@ -270,95 +889,360 @@ public:
 		return cursor_move + dump_buffer_to_tuple<Tup, idx + 1>(tup, ptr + cursor_move);
 	}
 
-	static constexpr size_t to_string_repeat_limit = 64;
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::has_mapped_type<Tp>::value,
+		size_t> deserialize_entry(Tp& assoc, deser_src ptr) {
+		typename Tp::key_type key{};
+		typename Tp::mapped_type value{};
+		size_t cursor = deserialize(key, ptr);
+		cursor += deserialize(value, ptr + cursor);
+		assoc.emplace_hint(assoc.end(), std::move(key), std::move(value));
+		return cursor;
+	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<
-		(!std::is_same<std::string, std::decay_t<Tp>>::value) &&
-		serdes::is_container_v<std::decay_t<Tp>>,
-		std::string> to_string(const Tp& vec) {
-		std::string ret = "{";
-		size_t repeat = 0;
-		for (auto& elem : vec) {
-			if (repeat++ < to_string_repeat_limit)
-				ret += to_string(elem) + (repeat != vec.size() ? ", " : "");
-			else {
-				ret += "...";
-				break;
-			}
-		}
-		ret += "}";
-		return ret;
+	static inline std::enable_if_t<!serdes::has_mapped_type<Tp>::value,
+		size_t> deserialize_entry(Tp& assoc, deser_src ptr) {
+		typename Tp::key_type key{};
+		const size_t cursor = deserialize(key, ptr);
+		assoc.emplace_hint(assoc.end(), std::move(key));
+		return cursor;
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<
-		std::is_same<std::string, std::decay_t<Tp>>::value &&
-		serdes::is_container_v<std::decay_t<Tp>>,
-		std::string> to_string(const Tp& vec) {
-		return std::string("\"" + vec + "\"");
+	static inline std::enable_if_t<serdes::has_reserve<Tp>::value,
+		void> reserve_entries(Tp& assoc, size_t elem_nums) {
+		assoc.reserve(elem_nums);
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<
-		serdes::is_std_array_v<std::decay_t<Tp>>,
-		std::string> to_string(const Tp& vec) {
-		std::string ret = "{";
-		size_t repeat = 0;
-		for (auto& elem : vec) {
-			if (repeat++ < to_string_repeat_limit)
-				ret += to_string(elem) + (repeat != vec.size() ? ", " : "");
-			else {
-				ret += "...";
-				break;
-			}
-		}
-		ret += "}";
-		return ret;
+	static inline std::enable_if_t<!serdes::has_reserve<Tp>::value,
+		void> reserve_entries(Tp&, size_t) {}
+
+	// Encoded size of a Tp at ptr, without decoding it.
+	// Only element counts are read, fixed size subtrees are skipped in O(1).
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		using elem_Tp = typename std::decay_t<Tp>::value_type;
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
+		if (is_fixed_size<elem_Tp>())
+			return cursor + elem_nums * fixed_size<elem_Tp>();
+		for (size_t i = 0; i < elem_nums; i++)
+			cursor += skip<elem_Tp>(ptr + cursor);
+		return cursor;
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
-		std::string> to_string(const Tp& c_str) {
-		return std::string(c_str);
+	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		using elem_Tp = typename std::decay_t<Tp>::value_type;
+		if (is_fixed_size<elem_Tp>())
+			return fixed_size<Tp>();
+		size_t cursor = 0;
+		for (size_t i = 0; i < std::tuple_size<std::decay_t<Tp>>::value; i++)
+			cursor += skip<elem_Tp>(ptr + cursor);
+		return cursor;
 	}
 
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
-		std::string> to_string(const Tp& tup) {
-		return "{" + tuple_to_string(tup) + "}";
+		size_t> skip(deser_src ptr) {
+		return tuple_skip<std::decay_t<Tp>, 0, std::tuple_size<std::decay_t<Tp>>::value>(ptr);
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<!is_serdes_special<Tp> && std::is_arithmetic<Tp>::value,
-		std::string> to_string(const Tp& src) {
-		return std::to_string(src);
+	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		size_t elem_nums = 0;
+		return extract_count(ptr, elem_nums) + elem_nums;
 	}
 
-#if _CXXABI_H
 	template<typename Tp>
-	static inline constexpr std::string type_name() {
-		std::string ret("UNKOWN_TYPE");
-		int status = 0;
-		char *realname = abi::__cxa_demangle(typeid(Tp).name(), nullptr, nullptr, &status);
-		if (status != 0) {
-			assert(status == 0 && "__cxa_demangle fail");
-			return ret;
+	static inline constexpr std::enable_if_t<serdes::is_bit_vector_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		size_t elem_nums = 0;
+		return extract_count(ptr, elem_nums) + (elem_nums + 7) / 8;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_associative_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
+		if (entry_fixed_size<std::decay_t<Tp>>() != 0)
+			return cursor + elem_nums * entry_fixed_size<std::decay_t<Tp>>();
+		for (size_t i = 0; i < elem_nums; i++)
+			cursor += skip_entry<std::decay_t<Tp>>(ptr + cursor);
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
+		size_t> skip(deser_src) {
+		return sizeof(Tp);
+	}
+
+	// Encoded size of the tuple elements [idx, end)
+	template<class Tup, size_t idx, size_t end>
+	static inline constexpr std::enable_if_t<!(idx < end),
+		size_t> tuple_skip(deser_src) {
+		return (size_t)0;
+	}
+
+	template<class Tup, size_t idx, size_t end>
+	static inline constexpr std::enable_if_t<(idx < end),
+		size_t> tuple_skip(deser_src ptr) {
+		size_t cursor_move = skip<typename std::tuple_element<idx, Tup>::type>(ptr);
+		return cursor_move + tuple_skip<Tup, idx + 1, end>(ptr + cursor_move);
+	}
+
+	// Encoded size of an associative container entry, 0 when not fixed
+	template<class Tp>
+	static inline constexpr std::enable_if_t<serdes::has_mapped_type<Tp>::value,
+		size_t> entry_fixed_size() {
+		return is_fixed_size<typename Tp::key_type>() && is_fixed_size<typename Tp::mapped_type>() ?
+			fixed_size<typename Tp::key_type>() + fixed_size<typename Tp::mapped_type>() : (size_t)0;
+	}
+
+	template<class Tp>
+	static inline constexpr std::enable_if_t<!serdes::has_mapped_type<Tp>::value,
+		size_t> entry_fixed_size() {
+		return fixed_size<typename Tp::key_type>();
+	}
+
+	template<class Tp>
+	static inline constexpr std::enable_if_t<serdes::has_mapped_type<Tp>::value,
+		size_t> skip_entry(deser_src ptr) {
+		const size_t cursor = skip<typename Tp::key_type>(ptr);
+		return cursor + skip<typename Tp::mapped_type>(ptr + cursor);
+	}
+
+	template<class Tp>
+	static inline constexpr std::enable_if_t<!serdes::has_mapped_type<Tp>::value,
+		size_t> skip_entry(deser_src ptr) {
+		return skip<typename Tp::key_type>(ptr);
+	}
+
+	// Lazy read-only view of serialized data.
+	// Nothing is decoded until a leaf is read, so only the touched bytes are accessed
+	// (e.g. pages of a memory mapped file are faulted in on demand).
+	template<typename Tp, typename = void>
+	class LazyView {
+	public:
+		explicit LazyView(const buf_t* ptr) : data(ptr) {}
+		inline Tp get() const { return extract<Tp>(data); }
+		inline size_t decode(Tp& dst) const { return deserialize(dst, data); }
+		inline size_t encoded_size() const { return skip<Tp>(data); }
+		const buf_t* const data;
+	};
+
+	template<typename Tp>
+	class LazyView<Tp, std::enable_if_t<serdes::is_std_tuple_v<Tp>>> {
+	public:
+		explicit LazyView(const buf_t* ptr) : data(ptr) {}
+
+		template<size_t idx>
+		inline LazyView<typename std::tuple_element<idx, Tp>::type> get() const {
+			return LazyView<typename std::tuple_element<idx, Tp>::type>(data + tuple_skip<Tp, 0, idx>(data));
 		}
-		ret = std::string(realname);
-		free(realname);
+
+		inline size_t decode(Tp& dst) const { return deserialize(dst, data); }
+		inline size_t encoded_size() const { return skip<Tp>(data); }
+		const buf_t* const data;
+	};
+
+	template<typename Tp>
+	class LazyView<Tp, std::enable_if_t<serdes::is_container_v<Tp> || serdes::is_std_array_v<Tp>>> {
+		using elem_Tp = typename Tp::value_type;
+		static constexpr bool has_count = serdes::is_container_v<Tp>;
+	public:
+		explicit LazyView(const buf_t* ptr) : data(ptr), elem_nums(0), elems(ptr) {
+			if (has_count)
+				elems += extract_count(ptr, elem_nums);
+			else
+				elem_nums = array_elems();
+		}
+
+		inline size_t size() const { return elem_nums; }
+
+		// O(1) for fixed size elements, otherwise the preceding elements are skipped.
+		inline LazyView<elem_Tp> operator[](size_t idx) const {
+			assert(idx < elem_nums && "index out of range");
+			if (is_fixed_size<elem_Tp>())
+				return LazyView<elem_Tp>(elems + idx * fixed_size<elem_Tp>());
+			const buf_t* ptr = elems;
+			for (size_t i = 0; i < idx; i++)
+				ptr += skip<elem_Tp>(ptr);
+			return LazyView<elem_Tp>(ptr);
+		}
+
+		inline size_t decode(Tp& dst) const { return deserialize(dst, data); }
+		inline size_t encoded_size() const { return skip<Tp>(data); }
+		const buf_t* const data;
+
+	private:
+		template<typename Arr = Tp>
+		static inline constexpr std::enable_if_t<serdes::is_std_array_v<Arr>, size_t> array_elems() {
+			return std::tuple_size<Arr>::value;
+		}
+
+		template<typename Arr = Tp>
+		static inline constexpr std::enable_if_t<!serdes::is_std_array_v<Arr>, size_t> array_elems() {
+			return 0;
+		}
+
+		size_t elem_nums;
+		const buf_t* elems;
+	};
+
+	static constexpr size_t to_string_repeat_limit = 64; // text form only, JSON is complete
+
+	// Appends the text form of 'src' to 'out'. Reusing 'out' (clear() keeps the capacity)
+	// formats without allocating.
+	template<typename Tp>
+	static inline void format_to(std::string& out, const Tp& src) {
+		format_value<false>(out, src);
+	}
+
+	// Appends 'src' as JSON : tuples, arrays and containers are arrays, maps with std::string keys
+	// objects, other maps arrays of [key, value], an empty optional null.
+	template<typename Tp>
+	static inline void format_json(std::string& out, const Tp& src) {
+		format_value<true>(out, src);
+	}
+
+	template<typename Tp>
+	static inline std::string to_string(const Tp& src) {
+		std::string ret;
+		format_to(ret, src);
 		return ret;
 	}
-#else
+
 	template<typename Tp>
-	static inline constexpr std::string type_name() {
-		return typeid(Tp).name();
+	static inline std::string to_json(const Tp& src) {
+		std::string ret;
+		format_json(ret, src);
+		return ret;
+	}
+
+	// Former API : the to_string() of the tuple elements, without the braces
+	template<class Tup>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tup>, std::string> tuple_to_string(const Tup& tup) {
+		std::string ret;
+		tuple_format<false>(ret, tup);
+		return ret;
+	}
+
+private:
+	template<bool json, typename Tp>
+	static inline void format_elements(std::string& out, const Tp& elems) {
+		out += json ? '[' : '{';
+		size_t repeat = 0;
+		for (const auto& elem : elems) {
+			if (repeat != 0)
+				out += json ? "," : ", ";
+			if (!json && repeat == to_string_repeat_limit) {
+				out += "...";
+				break;
+			}
+			repeat++;
+			format_value<json>(out, elem);
+		}
+		out += json ? ']' : '}';
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<
+		(!std::is_same<std::string, Tp>::value) &&
+		(serdes::is_container_v<Tp> || serdes::is_std_array_v<Tp> || serdes::is_bit_vector_v<Tp>)> format_value(std::string& out, const Tp& vec) {
+		format_elements<json>(out, vec);
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<std::is_same<std::string, Tp>::value> format_value(std::string& out, const Tp& str) {
+		if (json)
+			return serdes::append_json_string(out, str.data(), str.size());
+		out += '"';
+		out += str;
+		out += '"';
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<serdes::is_c_string_v<Tp>> format_value(std::string& out, const Tp& c_str) {
+		if (!c_str)
+			out += json ? "null" : "";
+		else if (json)
+			serdes::append_json_string(out, c_str, strlen(c_str));
+		else
+			out += c_str;
 	}
-#endif
 
+	// JSON objects need string keys
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<!is_serdes_special<Tp> && !std::is_arithmetic<Tp>::value,
-		std::string> to_string(const Tp& src) {
+	static constexpr bool is_string_keyed = serdes::has_mapped_type<Tp>::value &&
+		std::is_same<std::string, typename Tp::key_type>::value;
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<Tp>> format_value(std::string& out, const Tp& assoc) {
+		constexpr bool braces = !json || is_string_keyed<Tp>;
+		out += braces ? '{' : '[';
+		size_t repeat = 0;
+		for (auto& entry : assoc) {
+			if (repeat != 0)
+				out += json ? "," : ", ";
+			if (!json && repeat == to_string_repeat_limit) {
+				out += "...";
+				break;
+			}
+			repeat++;
+			format_entry<json, braces>(out, entry);
+		}
+		out += braces ? '}' : ']';
+	}
+
+	template<bool json, bool object, typename K, typename V>
+	static inline void format_entry(std::string& out, const std::pair<K, V>& entry) {
+		if (json && !object)
+			out += '[';
+		format_value<json>(out, entry.first);
+		out += !json ? ": " : object ? ":" : ",";
+		format_value<json>(out, entry.second);
+		if (json && !object)
+			out += ']';
+	}
+
+	template<bool json, bool object, typename Tp>
+	static inline void format_entry(std::string& out, const Tp& key) {
+		format_value<json>(out, key);
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>> format_value(std::string& out, const Tp& tup) {
+		out += json ? '[' : '{';
+		tuple_format<json>(out, tup);
+		out += json ? ']' : '}';
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp> && std::is_same<bool, Tp>::value> format_value(std::string& out, const Tp& src) {
+		out += json ? (src ? "true" : "false") : (src ? "1" : "0");
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp> && std::is_integral<Tp>::value && !std::is_same<bool, Tp>::value>
+		format_value(std::string& out, const Tp& src) {
+		serdes::append_integer(out, src);
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp> && std::is_floating_point<Tp>::value> format_value(std::string& out, const Tp& src) {
+		serdes::append_float(out, src, json);
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp> && !std::is_arithmetic<Tp>::value> format_value(std::string& out, const Tp& src) {
 		// require c++20 
 		//		GCC 9.0.0	: 201709L. for C++2a. (tested)
 		//		Clang 8.0.0	: 201707L.
@@ -368,16 +1252,47 @@ public:
       (defined(__GNUC__) ? __GNUC__ > 8 : true)))
 		auto&& tup = to_tuple(src);
 		if constexpr (std::tuple_size<std::decay_t<decltype(tup)>>::value > 0) {
-			return to_string(tup);
+			return format_value<json>(out, tup);
 		}
 		else // cannot convert structure to tuple
-			return type_name<Tp>();
+			format_type_name<json, Tp>(out);
 #else
 		UNUSED(src);
-		return type_name<Tp>();
+		format_type_name<json, Tp>(out);
 #endif
 	}
 
+	template<bool json, typename Tp>
+	static inline void format_type_name(std::string& out) {
+		const std::string name = type_name<Tp>();
+		if (json)
+			serdes::append_json_string(out, name.data(), name.size());
+		else
+			out += name;
+	}
+
+public:
+#if _CXXABI_H
+	template<typename Tp>
+	static inline constexpr std::string type_name() {
+		std::string ret("UNKOWN_TYPE");
+		int status = 0;
+		char *realname = abi::__cxa_demangle(typeid(Tp).name(), nullptr, nullptr, &status);
+		if (status != 0) {
+			assert(status == 0 && "__cxa_demangle fail");
+			return ret;
+		}
+		ret = std::string(realname);
+		free(realname);
+		return ret;
+	}
+#else
+	template<typename Tp>
+	static inline constexpr std::string type_name() {
+		return typeid(Tp).name();
+	}
+#endif
+
 #if ((__cplusplus > 201703L) && \
 	 ((defined(_MSC_VER) && defined(__cpp_consteval)) || \
       (defined(__GNUC__) ? __GNUC__ > 8 : true)))
@@ -391,16 +1306,20 @@ public:
 	template<typename T>
 	static consteval auto member_count(auto&& ...member) {
 		if constexpr (requires{ T{ member... }; } == false)
-			return sizeof...(Members) - 1;
+			return sizeof...(member) - 1;
 		else
 			return member_count<T>(member..., any{});
 	}
 
-	// only structures with up to 16 elements are supported 
+	// only aggregates with up to 16 elements are supported (a user-declared constructor
+	// makes T{ any } a copy and hides the member count, so such structures map to no tuple)
 	template<class T>
 	static inline constexpr auto to_tuple(T&& object) noexcept {
 		using type = std::decay_t<T>;
-		if constexpr (member_count<type>() == 0x10) {
+		if constexpr (!std::is_aggregate_v<type>) {
+			return std::forward_as_tuple();
+		}
+		else if constexpr (member_count<type>() == 0x10) {
 			auto&&[p0, p1, p2, p3, p4, p5, p6, p7, p8, p9, pA, pB, pC, pD, pE, pF] = object;
 			return std::forward_as_tuple(p0, p1, p2, p3, p4, p5, p6, p7, p8, p9, pA, pB, pC, pD, pE, pF);
 		}
@@ -471,22 +1390,16 @@ public:
 
 #endif
 
-	template<class Tup, size_t idx>
-	static inline constexpr std::enable_if_t<
-		serdes::is_std_tuple_v<Tup> &&
-		!(idx < std::tuple_size<Tup>::value),
-		std::string> tuple_to_string(const Tup&) {
-		// do notting
-		return std::string();
-	}
+private:
+	template<bool json, size_t idx = 0, class Tup>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value)> tuple_format(std::string&, const Tup&) {}
 
-	template<class Tup, size_t idx = 0>
-	static inline constexpr std::enable_if_t<
-		serdes::is_std_tuple_v<Tup> &&
-		(idx < std::tuple_size<Tup>::value),
-		std::string> tuple_to_string(const Tup& tup) {
-		constexpr const char* delimiter = idx == 0 ? "" : ", ";
-		return delimiter + to_string(std::get<idx>(tup)) + tuple_to_string<Tup, idx + 1>(tup);
+	template<bool json, size_t idx = 0, class Tup>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value)> tuple_format(std::string& out, const Tup& tup) {
+		if (idx != 0)
+			out += json ? "," : ", ";
+		format_value<json>(out, std::get<idx>(tup));
+		tuple_format<json, idx + 1>(out, tup);
 	}
 
 
@@ -525,16 +1438,40 @@ public:
 #endif
 	}
 
+	static inline size_t inject_count(ser_dst ptr, size_t count) {
+		if ((uint64_t)count < large_count_marker) {
+			inject<uint32_t>(ptr, (uint32_t)count);
+			return sizeof(uint32_t);
+		}
+		inject<uint32_t>(ptr, (uint32_t)large_count_marker);
+		inject<uint64_t>(ptr + sizeof(uint32_t), (uint64_t)count);
+		return sizeof(uint32_t) + sizeof(uint64_t);
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
 		size_t>	serialize(ser_dst ptr, const Tp& vec) {
-		inject<uint32_t>(ptr, (uint32_t)vec.size());
-		size_t cursor = sizeof(uint32_t);
+		size_t cursor = inject_count(ptr, vec.size());
 		for (auto& elem : vec)
 			cursor += serialize(ptr + cursor, elem);
 		return cursor;
 	}
 
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_bit_vector_v<std::decay_t<Tp>>,
+		size_t>	serialize(ser_dst ptr, const Tp& vec) {
+		const size_t cursor = inject_count(ptr, vec.size());
+		auto it = vec.begin();
+		for (size_t i = 0; i < vec.size(); i += 8) {
+			uint8_t byte = 0;
+			const size_t nums = std::min<size_t>(8, vec.size() - i);
+			for (size_t bit = 0; bit < nums; bit++, ++it)
+				byte |= (uint8_t)((*it ? 1 : 0) << bit);
+			ptr[cursor + i / 8] = (buf_t)byte;
+		}
+		return cursor + (vec.size() + 7) / 8;
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
 		size_t>	serialize(ser_dst ptr, const Tp& arr) {
@@ -556,6 +1493,15 @@ public:
 		return serialize(ptr, std::string(c_str));
 	}
 
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_associative_v<std::decay_t<Tp>>,
+		size_t> serialize(ser_dst ptr, const Tp& assoc) {
+		size_t cursor = inject_count(ptr, assoc.size());
+		for (auto& entry : assoc)
+			cursor += serialize_entry(ptr + cursor, entry);
+		return cursor;
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
 		size_t> serialize(ser_dst ptr, const Tp& src) {
@@ -583,15 +1529,26 @@ public:
 
 
 
+	static inline constexpr size_t count_size(size_t count) {
+		return (uint64_t)count < large_count_marker ?
+			sizeof(uint32_t) : sizeof(uint32_t) + sizeof(uint64_t);
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
 		size_t>	payload_size(const Tp& vec) {
-		size_t cursor = sizeof(uint32_t);
+		size_t cursor = count_size(vec.size());
 		for (auto& elem : vec)
 			cursor += payload_size(elem);
 		return cursor;
 	}
 
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_bit_vector_v<std::decay_t<Tp>>,
+		size_t>	payload_size(const Tp& vec) {
+		return count_size(vec.size()) + (vec.size() + 7) / 8;
+	}
+
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
 		size_t>	payload_size(const Tp& arr) {
@@ -610,7 +1567,18 @@ public:
 	template<typename Tp>
 	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
 		size_t> payload_size(const Tp& c_str) {
-		return std::string(c_str).size();
+		return payload_size(std::string(c_str));
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_associative_v<std::decay_t<Tp>>,
+		size_t> payload_size(const Tp& assoc) {
+		if (entry_fixed_size<std::decay_t<Tp>>() != 0)
+			return count_size(assoc.size()) + assoc.size() * entry_fixed_size<std::decay_t<Tp>>();
+		size_t cursor = count_size(assoc.size());
+		for (auto& entry : assoc)
+			cursor += entry_payload_size(entry);
+		return cursor;
 	}
 
 	template<typename Tp>
@@ -638,80 +1606,1765 @@ public:
 		return cursor_move + tuple_payload_size<Tup, idx + 1>(tup);
 	}
 
+	template<typename K, typename V>
+	static inline size_t serialize_entry(ser_dst ptr, const std::pair<K, V>& entry) {
+		const size_t cursor = serialize(ptr, entry.first);
+		return cursor + serialize(ptr + cursor, entry.second);
+	}
 
-	// require c++20 
-	//		GCC 9.0.0	: 201709L. for C++2a.
-	//		Clang 8.0.0	: 201707L.
-	//		VC++ 15.9.3	: 201704L.
-#if __cplusplus > 201703L && (defined(__GNUC__) ? __GNUC__ > 8 : true)
+	template<typename Tp>
+	static inline size_t serialize_entry(ser_dst ptr, const Tp& key) {
+		return serialize(ptr, key);
+	}
+
+	template<typename K, typename V>
+	static inline size_t entry_payload_size(const std::pair<K, V>& entry) {
+		return payload_size(entry.first) + payload_size(entry.second);
+	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
-		size_t> elem_nums() {
-		return elem_nums<Tp::value_type>();
+	static inline size_t entry_payload_size(const Tp& key) {
+		return payload_size(key);
 	}
 
+#if __cplusplus >= 201703L
+	//----------------------------------------------------------------------------------------------
+	// std::optional : engaged flag(uint8_t) + value
+	// std::variant  : alternative index(uint8_t, variant_valueless when valueless) + alternative
+	//----------------------------------------------------------------------------------------------
+
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
-		size_t> elem_nums() {
-		return elem_nums<Tp::value_type>() * std::tuple_size<Tp>::value;
+	static inline constexpr std::enable_if_t<serdes::is_std_optional_v<std::decay_t<Tp>>,
+		size_t> serialize(ser_dst ptr, const Tp& opt) {
+		inject<uint8_t>(ptr, opt ? (uint8_t)1 : (uint8_t)0);
+		return sizeof(uint8_t) + (opt ? serialize(ptr + sizeof(uint8_t), *opt) : (size_t)0);
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
-		size_t> elem_nums() {
-		return tuple_elem_nums<Tp>();
+	static inline constexpr std::enable_if_t<serdes::is_std_optional_v<std::decay_t<Tp>>,
+		size_t> deserialize(Tp& opt, deser_src ptr) {
+		if (extract<uint8_t>(ptr) == 0) {
+			opt.reset();
+			return sizeof(uint8_t);
+		}
+		if (!opt)
+			opt.emplace();
+		return sizeof(uint8_t) + deserialize(*opt, ptr + sizeof(uint8_t));
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
-		size_t> elem_nums() {
-		return (size_t)1;
+	static inline constexpr std::enable_if_t<serdes::is_std_optional_v<std::decay_t<Tp>>,
+		size_t> payload_size(const Tp& opt) {
+		return sizeof(uint8_t) + (opt ? payload_size(*opt) : (size_t)0);
 	}
 
 	template<typename Tp>
-	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
-		size_t> elem_nums() {
-		return (size_t)1;
+	static inline constexpr std::enable_if_t<serdes::is_std_optional_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		return sizeof(uint8_t) + (extract<uint8_t>(ptr) ? skip<typename std::decay_t<Tp>::value_type>(ptr + sizeof(uint8_t)) : (size_t)0);
 	}
 
-	template<class Tup, size_t idx>
-	static inline constexpr std::enable_if_t<
-		serdes::is_std_tuple_v<Tup> &&
-		!(idx < std::tuple_size<Tup>::value),
-		size_t> tuple_elem_nums() {
-		// do notting
-		return (size_t)0;
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_variant_v<std::decay_t<Tp>>,
+		size_t> serialize(ser_dst ptr, const Tp& var) {
+		if (var.valueless_by_exception()) {
+			inject<uint8_t>(ptr, (uint8_t)variant_valueless);
+			return sizeof(uint8_t);
+		}
+		inject<uint8_t>(ptr, (uint8_t)var.index());
+		return sizeof(uint8_t) + std::visit([ptr](const auto& alt) { return serialize(ptr + sizeof(uint8_t), alt); }, var);
 	}
 
-	template<class Tup, size_t idx = 0>
-	static inline constexpr std::enable_if_t<
-		serdes::is_std_tuple_v<Tup> &&
-		(idx < std::tuple_size<Tup>::value),
-		size_t> tuple_elem_nums() {
-		return elem_nums<std::tuple_element<idx, Tup>::type>() + tuple_elem_nums<Tup, idx + 1>();
+	// The current alternative is decoded in place when the index matches.
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_variant_v<std::decay_t<Tp>>,
+		size_t> deserialize(Tp& var, deser_src ptr) {
+		const size_t index = extract<uint8_t>(ptr);
+		assert(index != variant_valueless && "valueless variant");
+		return sizeof(uint8_t) + variant_deserialize<std::decay_t<Tp>, 0>(var, index, ptr + sizeof(uint8_t));
 	}
 
-#endif
-};
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_variant_v<std::decay_t<Tp>>,
+		size_t> payload_size(const Tp& var) {
+		if (var.valueless_by_exception())
+			return sizeof(uint8_t);
+		return sizeof(uint8_t) + std::visit([](const auto& alt) { return payload_size(alt); }, var);
+	}
 
-typedef SerDes<uint8_t, false> SerDesLittle;
-typedef SerDes<uint8_t, true> SerDesBig;
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_variant_v<std::decay_t<Tp>>,
+		size_t> skip(deser_src ptr) {
+		return sizeof(uint8_t) + variant_skip<std::decay_t<Tp>, 0>(extract<uint8_t>(ptr), ptr + sizeof(uint8_t));
+	}
 
-#pragma pack(push, 1) 
-typedef struct length_header {
-	static constexpr int length_bits = 24;
-	static constexpr int checksum_bits = 8;
+private:
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<serdes::is_std_optional_v<Tp>> format_value(std::string& out, const Tp& opt) {
+		if (opt)
+			format_value<json>(out, *opt);
+		else
+			out += json ? "null" : "nullopt";
+	}
+
+	template<bool json, typename Tp>
+	static inline std::enable_if_t<serdes::is_std_variant_v<Tp>> format_value(std::string& out, const Tp& var) {
+		if (var.valueless_by_exception())
+			out += json ? "null" : "valueless";
+		else
+			std::visit([&out](const auto& alt) { format_value<json>(out, alt); }, var);
+	}
+
+	template<class Var, size_t idx>
+	static inline std::enable_if_t<!(idx < std::variant_size<Var>::value),
+		size_t> variant_deserialize(Var&, size_t, deser_src) {
+		return (size_t)0;
+	}
+
+	template<class Var, size_t idx>
+	static inline std::enable_if_t<(idx < std::variant_size<Var>::value),
+		size_t> variant_deserialize(Var& var, size_t index, deser_src ptr) {
+		if (index != idx)
+			return variant_deserialize<Var, idx + 1>(var, index, ptr);
+		if (var.index() != idx)
+			var.template emplace<idx>();
+		return deserialize(*std::get_if<idx>(&var), ptr);
+	}
+
+	template<class Var, size_t idx>
+	static inline std::enable_if_t<!(idx < std::variant_size<Var>::value),
+		size_t> variant_skip(size_t, deser_src) {
+		return (size_t)0;
+	}
+
+	template<class Var, size_t idx>
+	static inline std::enable_if_t<(idx < std::variant_size<Var>::value),
+		size_t> variant_skip(size_t index, deser_src ptr) {
+		if (index != idx)
+			return variant_skip<Var, idx + 1>(index, ptr);
+		return skip<std::variant_alternative_t<idx, Var>>(ptr);
+	}
+
+public:
+#endif
+
+	//----------------------------------------------------------------------------------------------
+	// Fixed size encoding
+	//----------------------------------------------------------------------------------------------
+
+	// Same bytes as serialize(), for fixed size types (is_fixed_size_v), returned by value.
+	// Every field is stored at an offset known at compile time, without cursors.
+	// Integers are stored with shifts, so types made of integers encode in constant expressions;
+	// floating point fields and structures need std::bit_cast (C++20) to do the same.
+	template<typename Tp>
+	static inline constexpr std::array<buf_t, fixed_size<Tp>()> serialize_fixed(const Tp& src) {
+		static_assert(is_fixed_size_v<Tp>, "not a fixed size type");
+		buf_t bytes[fixed_size<Tp>() + 1] = {}; // std::array is not writable in C++14 constant expressions
+		store_fixed<0>(bytes, src);
+		return to_fixed_array(bytes, std::make_index_sequence<fixed_size<Tp>()>{});
+	}
+
+private:
+	template<size_t N, size_t... I>
+	static inline constexpr std::array<buf_t, sizeof...(I)> to_fixed_array(const buf_t (&bytes)[N], std::index_sequence<I...>) {
+		return std::array<buf_t, sizeof...(I)>{ { bytes[I]... } };
+	}
+
+	// Low 'size' bytes of 'bits' in little endian order, reversed for big_endian
+	template<size_t offset, size_t size, bool reverse, typename Tp>
+	static inline constexpr void store_bytes(buf_t* out, Tp bits) {
+		for (size_t i = 0; i < size; i++)
+			out[offset + (reverse ? size - 1 - i : i)] = (buf_t)(bits >> (8 * i) & 0xFF);
+	}
+
+	template<size_t offset, typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp> && (std::is_integral<Tp>::value || std::is_enum<Tp>::value)>
+		store_fixed(buf_t* out, const Tp& src) {
+		store_bytes<offset, sizeof(Tp), big_endian>(out, (uint64_t)src);
+	}
+
+	// floating point values are never byte swapped (see inject)
+	template<size_t offset, typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp> && std::is_floating_point<Tp>::value>
+		store_fixed(buf_t* out, const Tp& src) {
+#ifdef __cpp_lib_bit_cast
+		typedef std::conditional_t<sizeof(Tp) == sizeof(uint64_t), uint64_t, uint32_t> bits_type;
+		if constexpr (sizeof(Tp) == sizeof(bits_type))
+			store_bytes<offset, sizeof(Tp), false>(out, std::bit_cast<bits_type>(src));
+		else
+			memcpy(out + offset, &src, sizeof(Tp));
+#else
+		memcpy(out + offset, &src, sizeof(Tp));
+#endif
+	}
+
+	template<size_t offset, typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp> && !std::is_arithmetic<Tp>::value && !std::is_enum<Tp>::value>
+		store_fixed(buf_t* out, const Tp& src) {
+#ifdef __cpp_lib_bit_cast
+		const auto image = std::bit_cast<std::array<buf_t, sizeof(Tp)>>(src);
+		for (size_t i = 0; i < sizeof(Tp); i++)
+			out[offset + (big_endian ? sizeof(Tp) - 1 - i : i)] = image[i];
+#else
+		inject(out + offset, src);
+#endif
+	}
+
+	template<size_t offset, typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_array_v<Tp>> store_fixed(buf_t* out, const Tp& arr) {
+		store_fixed_elements<offset, 0>(out, arr);
+	}
+
+	template<size_t offset, typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_tuple_v<Tp>> store_fixed(buf_t* out, const Tp& tup) {
+		store_fixed_elements<offset, 0>(out, tup);
+	}
+
+	template<size_t offset, size_t idx, typename Tp>
+	static inline constexpr std::enable_if_t<!(idx < std::tuple_size<Tp>::value)> store_fixed_elements(buf_t*, const Tp&) {}
+
+	template<size_t offset, size_t idx, typename Tp>
+	static inline constexpr std::enable_if_t<(idx < std::tuple_size<Tp>::value)> store_fixed_elements(buf_t* out, const Tp& src) {
+		typedef std::decay_t<std::tuple_element_t<idx, Tp>> elem_type;
+		store_fixed<offset>(out, std::get<idx>(src));
+		store_fixed_elements<offset + fixed_size<elem_type>(), idx + 1>(out, src);
+	}
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Delta encoding
+	//----------------------------------------------------------------------------------------------
+
+	// Patch of 'cur' against 'prev' : a changed flag(uint8_t), then for changed nodes
+	//  - tuple / std::array : bitmap of the changed elements + their patches
+	//  - container : new count + bitmap of the changed common elements + their patches
+	//                + the appended elements serialized in full
+	//  - scalar / C string : the new value
+	// The receiver applies it with apply_delta() on its copy of 'prev'.
+	// Returns the appended size.
+	template<typename Tp>
+	static inline size_t serialize_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		static_assert(is_serdesable_v<Tp>, "cannot convert");
+		const size_t base = dst.size();
+		dst.push_back((buf_t)1);
+		if (!append_delta(dst, prev, cur))
+			dst[base] = (buf_t)0; // identical, nothing follows
+		return dst.size() - base;
+	}
+
+	// Updates 'dst' (equal to the 'prev' of serialize_delta) in place, returns the consumed size.
+	template<typename Tp>
+	static inline size_t apply_delta(Tp& dst, deser_src ptr) {
+		if (ptr[0] == (buf_t)0)
+			return 1;
+		return 1 + patch_delta(dst, ptr + 1);
+	}
+
+private:
+	static inline constexpr size_t bitmap_size(size_t bits) {
+		return (bits + 7) / 8;
+	}
+
+	static inline bool bitmap_test(const buf_t* bitmap, size_t bit) {
+		return ((uint8_t)bitmap[bit / 8] >> (bit % 8)) & 1;
+	}
+
+	// Appends the patch and returns true when 'prev' and 'cur' differ, otherwise appends nothing.
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
+		bool> append_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		const size_t base = dst.size();
+		const size_t common = std::min(prev.size(), cur.size());
+		dst.resize(base + count_size(cur.size()) + bitmap_size(common));
+		const size_t bitmap = base + inject_count(dst.data() + base, cur.size());
+		bool changed = prev.size() != cur.size();
+		auto prev_it = prev.begin();
+		auto cur_it = cur.begin();
+		for (size_t i = 0; i < common; i++, ++prev_it, ++cur_it) {
+			if (append_delta(dst, *prev_it, *cur_it)) {
+				dst[bitmap + i / 8] = (buf_t)((uint8_t)dst[bitmap + i / 8] | (1U << (i % 8)));
+				changed = true;
+			}
+		}
+		for (; cur_it != cur.end(); ++cur_it) {
+			const size_t pos = dst.size();
+			dst.resize(pos + payload_size(*cur_it));
+			serialize(dst.data() + pos, *cur_it);
+		}
+		if (!changed)
+			dst.resize(base);
+		return changed;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		bool> append_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		const size_t base = dst.size();
+		dst.resize(base + bitmap_size(prev.size()));
+		bool changed = false;
+		for (size_t i = 0; i < prev.size(); i++) {
+			if (append_delta(dst, prev[i], cur[i])) {
+				dst[base + i / 8] = (buf_t)((uint8_t)dst[base + i / 8] | (1U << (i % 8)));
+				changed = true;
+			}
+		}
+		if (!changed)
+			dst.resize(base);
+		return changed;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		bool> append_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		const size_t base = dst.size();
+		dst.resize(base + bitmap_size(std::tuple_size<std::decay_t<Tp>>::value));
+		if (tuple_append_delta<std::decay_t<Tp>, 0>(dst, base, prev, cur))
+			return true;
+		dst.resize(base);
+		return false;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
+		bool> append_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		if (strcmp(prev, cur) == 0)
+			return false;
+		const size_t pos = dst.size();
+		dst.resize(pos + payload_size(cur));
+		serialize(dst.data() + pos, cur);
+		return true;
+	}
+
+	// associative containers, std::vector<bool>, optional and variant are compared and resent as a whole
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<std::decay_t<Tp>> || serdes::is_bit_vector_v<std::decay_t<Tp>> ||
+		serdes::is_std_optional_v<std::decay_t<Tp>> || serdes::is_std_variant_v<std::decay_t<Tp>>,
+		bool> append_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		if (prev == cur)
+			return false;
+		const size_t pos = dst.size();
+		dst.resize(pos + payload_size(cur));
+		serialize(dst.data() + pos, cur);
+		return true;
+	}
+
+	// bitwise compare, so a NaN that did not change is not resent
+	template<typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp>,
+		bool> append_delta(std::vector<buf_t>& dst, const Tp& prev, const Tp& cur) {
+		if (memcmp(&prev, &cur, sizeof(Tp)) == 0)
+			return false;
+		const size_t pos = dst.size();
+		dst.resize(pos + sizeof(Tp));
+		inject(dst.data() + pos, cur);
+		return true;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		bool> tuple_append_delta(std::vector<buf_t>&, size_t, const Tup&, const Tup&) {
+		return false;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		bool> tuple_append_delta(std::vector<buf_t>& dst, size_t bitmap, const Tup& prev, const Tup& cur) {
+		const bool changed = append_delta(dst, std::get<idx>(prev), std::get<idx>(cur));
+		if (changed)
+			dst[bitmap + idx / 8] = (buf_t)((uint8_t)dst[bitmap + idx / 8] | (1U << (idx % 8)));
+		return tuple_append_delta<Tup, idx + 1>(dst, bitmap, prev, cur) || changed;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
+		size_t> patch_delta(Tp& dst, deser_src ptr) {
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
+		const size_t common = std::min(dst.size(), elem_nums);
+		const buf_t* bitmap = ptr + cursor;
+		cursor += bitmap_size(common);
+		auto it = dst.begin();
+		for (size_t i = 0; i < common; i++, ++it)
+			if (bitmap_test(bitmap, i))
+				cursor += patch_delta(*it, ptr + cursor);
+		const size_t old_size = dst.size();
+		dst.resize(elem_nums);
+		it = dst.begin();
+		std::advance(it, (std::ptrdiff_t)std::min(old_size, elem_nums));
+		for (; it != dst.end(); ++it)
+			cursor += deserialize(*it, ptr + cursor);
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		size_t> patch_delta(Tp& dst, deser_src ptr) {
+		size_t cursor = bitmap_size(dst.size());
+		for (size_t i = 0; i < dst.size(); i++)
+			if (bitmap_test(ptr, i))
+				cursor += patch_delta(dst[i], ptr + cursor);
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		size_t> patch_delta(Tp& dst, deser_src ptr) {
+		const size_t bitmap_bytes = bitmap_size(std::tuple_size<std::decay_t<Tp>>::value);
+		return bitmap_bytes + tuple_patch_delta<std::decay_t<Tp>, 0>(dst, ptr, ptr + bitmap_bytes);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<is_encoded_whole<std::decay_t<Tp>>,
+		size_t> patch_delta(Tp& dst, deser_src ptr) {
+		return deserialize(dst, ptr);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_patch_delta(Tup&, const buf_t*, const buf_t*) {
+		return (size_t)0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_patch_delta(Tup& dst, const buf_t* bitmap, const buf_t* ptr) {
+		const size_t cursor_move = bitmap_test(bitmap, idx) ? patch_delta(std::get<idx>(dst), ptr) : 0;
+		return cursor_move + tuple_patch_delta<Tup, idx + 1>(dst, bitmap, ptr + cursor_move);
+	}
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Recycled decoding
+	//----------------------------------------------------------------------------------------------
+
+	// Same result as deserialize(), for a destination reused across messages.
+	// Existing elements are decoded in place at every nesting level, so inner strings and
+	// vectors only ever grow, and elements dropped by a shrinking container go to 'recycler'
+	// instead of being freed. Returns the consumed size.
+	template<typename Tp>
+	static inline size_t deserialize_recycled(Tp& dst, deser_src ptr, DecodeRecycler& recycler) {
+		return recycle_into(dst, ptr, recycler);
+	}
+
+private:
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
+		size_t> recycle_into(Tp& vec, deser_src ptr, DecodeRecycler& recycler) {
+		using elem_Tp = typename std::decay_t<Tp>::value_type;
+		if (is_fixed_size<elem_Tp>()) // resize() keeps the capacity
+			return deserialize(vec, ptr);
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
+		if (elem_nums != vec.size())
+			resize_recycled(vec, elem_nums, recycler.template spares<elem_Tp>(), recycler.max_spares());
+		for (auto& elem : vec)
+			cursor += recycle_into(elem, ptr + cursor, recycler);
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		size_t> recycle_into(Tp& arr, deser_src ptr, DecodeRecycler& recycler) {
+		size_t cursor = 0;
+		for (auto& elem : arr)
+			cursor += recycle_into(elem, ptr + cursor, recycler);
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		size_t> recycle_into(Tp& tup, deser_src ptr, DecodeRecycler& recycler) {
+		return tuple_recycle_into<std::decay_t<Tp>, 0>(tup, ptr, recycler);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<is_encoded_whole<std::decay_t<Tp>>,
+		size_t> recycle_into(Tp& dst, deser_src ptr, DecodeRecycler&) {
+		return deserialize(dst, ptr);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_recycle_into(Tup&, deser_src, DecodeRecycler&) {
+		return (size_t)0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_recycle_into(Tup& tup, deser_src ptr, DecodeRecycler& recycler) {
+		const size_t cursor_move = recycle_into(std::get<idx>(tup), ptr, recycler);
+		return cursor_move + tuple_recycle_into<Tup, idx + 1>(tup, ptr + cursor_move, recycler);
+	}
+
+	template<typename Tp, typename Elem>
+	static inline void resize_recycled(Tp& vec, size_t elem_nums, std::vector<Elem>& spares, size_t max_spares) {
+		const size_t old_size = vec.size();
+		if (elem_nums < old_size) {
+			auto it = vec.begin();
+			std::advance(it, (std::ptrdiff_t)elem_nums);
+			for (; it != vec.end() && spares.size() < max_spares; ++it)
+				spares.push_back(std::move(*it));
+			vec.resize(elem_nums);
+			return;
+		}
+		vec.resize(elem_nums);
+		auto it = vec.begin();
+		std::advance(it, (std::ptrdiff_t)old_size);
+		for (; it != vec.end() && !spares.empty(); ++it) {
+			std::swap(*it, spares.back());
+			spares.pop_back();
+		}
+	}
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Interned strings
+	//----------------------------------------------------------------------------------------------
+
+	// Same layout as serialize() except for std::string, written as a varint v :
+	//  - v & 1 == 0 : reference to dictionary entry v >> 1
+	//  - v & 1 == 1 : new string of v >> 1 bytes, added to the dictionary of both sides
+	// With a session dictionary repeated strings cost 1-2 bytes across messages,
+	// without one they are interned within the message only. Returns the appended size.
+	template<typename Tp>
+	static inline size_t serialize_interned(std::vector<buf_t>& dst, const Tp& src, StringDictionary& dict) {
+		static_assert(is_serdesable_v<Tp>, "cannot convert");
+		const size_t base = dst.size();
+		append_interned(dst, src, dict);
+		return dst.size() - base;
+	}
+
+	template<typename Tp>
+	static inline size_t serialize_interned(std::vector<buf_t>& dst, const Tp& src) {
+		StringDictionary dict;
+		return serialize_interned(dst, src, dict);
+	}
+
+	// Returns the read size, or 0 when a string refers to an entry missing from the dictionary.
+	template<typename Tp>
+	static inline size_t deserialize_interned(Tp& dst, deser_src ptr, StringDictionary& dict) {
+		return read_interned(dst, ptr, dict);
+	}
+
+	template<typename Tp>
+	static inline size_t deserialize_interned(Tp& dst, deser_src ptr) {
+		StringDictionary dict;
+		return read_interned(dst, ptr, dict);
+	}
+
+	// LEB128
+	static inline size_t inject_varint(ser_dst ptr, uint64_t value) {
+		size_t cursor = 0;
+		for (; value >= 0x80; value >>= 7)
+			ptr[cursor++] = (buf_t)((value & 0x7F) | 0x80);
+		ptr[cursor++] = (buf_t)value;
+		return cursor;
+	}
+
+	static inline size_t extract_varint(deser_src ptr, uint64_t& value) {
+		value = 0;
+		size_t cursor = 0;
+		for (uint32_t shift = 0; shift < 64; shift += 7) {
+			const uint8_t byte = (uint8_t)ptr[cursor++];
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		return cursor;
+	}
+
+	static constexpr size_t max_varint_size = 10;
+
+private:
+	template<typename Tp>
+	static inline std::enable_if_t<std::is_same<std::string, std::decay_t<Tp>>::value,
+		void> append_interned(std::vector<buf_t>& dst, const Tp& str, StringDictionary& dict) {
+		const uint32_t id = dict.find(str);
+		const size_t pos = dst.size();
+		if (id != StringDictionary::npos) {
+			dst.resize(pos + max_varint_size);
+			dst.resize(pos + inject_varint(dst.data() + pos, (uint64_t)id << 1));
+			return;
+		}
+		dst.resize(pos + max_varint_size + str.size());
+		const size_t cursor = inject_varint(dst.data() + pos, ((uint64_t)str.size() << 1) | 1);
+		memcpy(dst.data() + pos + cursor, str.data(), str.size());
+		dst.resize(pos + cursor + str.size());
+		dict.insert(str);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!std::is_same<std::string, std::decay_t<Tp>>::value &&
+		serdes::is_container_v<std::decay_t<Tp>>,
+		void> append_interned(std::vector<buf_t>& dst, const Tp& vec, StringDictionary& dict) {
+		if (is_fixed_size<typename std::decay_t<Tp>::value_type>()) // no string inside
+			return append_plain(dst, vec);
+		const size_t pos = dst.size();
+		dst.resize(pos + count_size(vec.size()));
+		inject_count(dst.data() + pos, vec.size());
+		for (auto& elem : vec)
+			append_interned(dst, elem, dict);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		void> append_interned(std::vector<buf_t>& dst, const Tp& arr, StringDictionary& dict) {
+		for (auto& elem : arr)
+			append_interned(dst, elem, dict);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		void> append_interned(std::vector<buf_t>& dst, const Tp& tup, StringDictionary& dict) {
+		tuple_append_interned<std::decay_t<Tp>, 0>(dst, tup, dict);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<is_encoded_whole<std::decay_t<Tp>>,
+		void> append_interned(std::vector<buf_t>& dst, const Tp& src, StringDictionary&) {
+		append_plain(dst, src);
+	}
+
+	template<typename Tp>
+	static inline void append_plain(std::vector<buf_t>& dst, const Tp& src) {
+		const size_t pos = dst.size();
+		dst.resize(pos + payload_size(src));
+		serialize(dst.data() + pos, src);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		void> tuple_append_interned(std::vector<buf_t>&, const Tup&, StringDictionary&) {}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		void> tuple_append_interned(std::vector<buf_t>& dst, const Tup& tup, StringDictionary& dict) {
+		append_interned(dst, std::get<idx>(tup), dict);
+		tuple_append_interned<Tup, idx + 1>(dst, tup, dict);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<std::is_same<std::string, std::decay_t<Tp>>::value,
+		size_t> read_interned(Tp& str, deser_src ptr, StringDictionary& dict) {
+		uint64_t value = 0;
+		const size_t cursor = extract_varint(ptr, value);
+		if ((value & 1) == 0) {
+			const std::string* entry = dict.at(value >> 1);
+			if (!entry) // unknown string reference
+				return 0;
+			str = *entry;
+			return cursor;
+		}
+		str.assign((const char*)(ptr + cursor), (size_t)(value >> 1));
+		dict.append(str);
+		return cursor + (size_t)(value >> 1);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!std::is_same<std::string, std::decay_t<Tp>>::value &&
+		serdes::is_container_v<std::decay_t<Tp>>,
+		size_t> read_interned(Tp& vec, deser_src ptr, StringDictionary& dict) {
+		if (is_fixed_size<typename std::decay_t<Tp>::value_type>())
+			return deserialize(vec, ptr);
+		size_t elem_nums = 0;
+		size_t cursor = extract_count(ptr, elem_nums);
+		vec.resize(elem_nums);
+		for (auto& elem : vec) {
+			const size_t elem_size = read_interned(elem, ptr + cursor, dict);
+			if (elem_size == 0) // variable size elements are never empty, 0 is a failure
+				return 0;
+			cursor += elem_size;
+		}
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		size_t> read_interned(Tp& arr, deser_src ptr, StringDictionary& dict) {
+		size_t cursor = 0;
+		for (auto& elem : arr) {
+			const size_t elem_size = read_interned(elem, ptr + cursor, dict);
+			if (elem_size == 0 && !is_fixed_size<typename std::decay_t<Tp>::value_type>())
+				return 0;
+			cursor += elem_size;
+		}
+		return cursor;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		size_t> read_interned(Tp& tup, deser_src ptr, StringDictionary& dict) {
+		return tuple_read_interned<std::decay_t<Tp>, 0>(tup, ptr, dict);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<is_encoded_whole<std::decay_t<Tp>>,
+		size_t> read_interned(Tp& dst, deser_src ptr, StringDictionary&) {
+		return deserialize(dst, ptr);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_read_interned(Tup&, deser_src, StringDictionary&) {
+		return (size_t)0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_read_interned(Tup& tup, deser_src ptr, StringDictionary& dict) {
+		const size_t cursor_move = read_interned(std::get<idx>(tup), ptr, dict);
+		if (cursor_move == 0 && !is_fixed_size<std::tuple_element_t<idx, Tup>>())
+			return 0;
+		if (!(idx + 1 < std::tuple_size<Tup>::value))
+			return cursor_move;
+		const size_t rest = tuple_read_interned<Tup, idx + 1>(tup, ptr + cursor_move, dict);
+		return rest == 0 ? 0 : cursor_move + rest;
+	}
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Tagged encoding
+	//----------------------------------------------------------------------------------------------
+
+	// Versioned layout of a tuple message, for tuples that gain fields over time :
+	//   message length(uint32_t, header included) + field count(uint16_t) + fields
+	//   field : tag(uint16_t) = index << 3 | wire kind, then the value
+	//   wire kind : 0..3 = value of 1, 2, 4 or 8 bytes, tag_length_prefixed = varint length + value
+	// Readers decode the fields they know in order and default the missing ones.
+	// Unknown trailing fields are not parsed, the message length jumps over them.
+	static constexpr size_t tagged_header_size = sizeof(uint32_t) + sizeof(uint16_t);
+	static constexpr uint16_t tag_length_prefixed = 4;
+	static constexpr size_t max_tagged_fields = 0xFFFF >> 3;
+
+	// Returns the appended size
+	template<typename Tup>
+	static inline size_t serialize_tagged(std::vector<buf_t>& dst, const Tup& src) {
+		static_assert(serdes::is_std_tuple_v<Tup> && is_serdesable_v<Tup>, "tagged messages are tuples");
+		static_assert(std::tuple_size<Tup>::value <= max_tagged_fields, "too many fields");
+		const size_t base = dst.size();
+		dst.resize(base + tagged_header_size);
+		tuple_append_tagged<Tup, 0>(dst, src);
+		const size_t size = dst.size() - base;
+		assert(size <= UINT32_MAX && "tagged message is too large");
+		inject<uint32_t>(dst.data() + base, (uint32_t)size);
+		inject<uint16_t>(dst.data() + base + sizeof(uint32_t), (uint16_t)std::tuple_size<Tup>::value);
+		return size;
+	}
+
+	// Returns the message length, or 0 when the message does not fit in 'available' bytes or a known
+	// field does not hold its type (fields are decoded with deserialize_checked).
+	// A message of the reader's schema (the same fields, in order) is decoded in one pass,
+	// the tag matching of older and newer messages is only done when that fails.
+	template<typename Tup>
+	static inline size_t deserialize_tagged(Tup& dst, deser_src ptr, size_t available) {
+		static_assert(serdes::is_std_tuple_v<Tup> && is_serdesable_v<Tup>, "tagged messages are tuples");
+		if (available < tagged_header_size)
+			return 0;
+		const size_t size = extract<uint32_t>(ptr);
+		if (size < tagged_header_size || size > available)
+			return 0;
+		const buf_t* cursor = ptr + tagged_header_size;
+		size_t fields = extract<uint16_t>(ptr + sizeof(uint32_t));
+		if (fields == std::tuple_size<Tup>::value && tuple_read_current<Tup, 0>(dst, cursor, ptr + size))
+			return size;
+		cursor = ptr + tagged_header_size;
+		return tuple_read_tagged<Tup, 0>(dst, cursor, fields, ptr + size) ? size : 0;
+	}
+
+private:
+	template<typename Tp>
+	static inline constexpr uint16_t tag_kind() {
+		return !is_fixed_size<Tp>() ? tag_length_prefixed :
+			fixed_size<Tp>() == 1 ? 0 : fixed_size<Tp>() == 2 ? 1 :
+			fixed_size<Tp>() == 4 ? 2 : fixed_size<Tp>() == 8 ? 3 : tag_length_prefixed;
+	}
+
+	// Value position and size of the field whose tag was read, false past 'end'
+	static inline bool tagged_value(uint16_t tag, const buf_t* ptr, const buf_t* end, const buf_t*& value, size_t& size) {
+		const uint16_t kind = tag & 7;
+		if (kind < tag_length_prefixed)
+			size = (size_t)1 << kind;
+		else if (kind == tag_length_prefixed) {
+			uint64_t length = 0;
+			uint32_t shift = 0;
+			for (;; shift += 7) {
+				if (ptr == end || shift >= 64)
+					return false;
+				const uint8_t byte = (uint8_t)*ptr++;
+				length |= (uint64_t)(byte & 0x7F) << shift;
+				if ((byte & 0x80) == 0)
+					break;
+			}
+			size = (size_t)length;
+		}
+		else
+			return false;
+		value = ptr;
+		return size <= (size_t)(end - ptr);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value)> tuple_append_tagged(std::vector<buf_t>&, const Tup&) {}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value)> tuple_append_tagged(std::vector<buf_t>& dst, const Tup& tup) {
+		typedef std::decay_t<std::tuple_element_t<idx, Tup>> elem_type;
+		constexpr uint16_t kind = tag_kind<elem_type>();
+		const size_t value_size = payload_size(std::get<idx>(tup));
+		size_t pos = dst.size();
+		dst.resize(pos + sizeof(uint16_t) + max_varint_size + value_size);
+		inject<uint16_t>(dst.data() + pos, (uint16_t)(idx << 3 | kind));
+		pos += sizeof(uint16_t);
+		if (kind == tag_length_prefixed)
+			pos += inject_varint(dst.data() + pos, value_size);
+		pos += serialize(dst.data() + pos, std::get<idx>(tup));
+		dst.resize(pos);
+		tuple_append_tagged<Tup, idx + 1>(dst, tup);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), bool> tuple_read_current(Tup&, const buf_t*&, const buf_t*) {
+		return true;
+	}
+
+	// Fast path : field 'idx' comes next with the tag of the reader's type
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value), bool> tuple_read_current(Tup& tup,
+		const buf_t*& cursor, const buf_t* end) {
+		typedef std::decay_t<std::tuple_element_t<idx, Tup>> elem_type;
+		constexpr uint16_t expected_tag = (uint16_t)(idx << 3 | tag_kind<elem_type>());
+		if (end - cursor < (std::ptrdiff_t)sizeof(uint16_t) || extract<uint16_t>(cursor) != expected_tag)
+			return false;
+		const buf_t* value;
+		size_t value_size;
+		if (!tagged_value(expected_tag, cursor + sizeof(uint16_t), end, value, value_size) ||
+			deserialize_checked(std::get<idx>(tup), value, value_size) != value_size)
+			return false;
+		cursor = value + value_size;
+		return tuple_read_current<Tup, idx + 1>(tup, cursor, end);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), bool> tuple_read_tagged(Tup&, const buf_t*&, size_t&, const buf_t*) {
+		return true;
+	}
+
+	// Fields come in index order. Older indexes (duplicates) are skipped, a larger index
+	// means the field 'idx' was not sent and keeps its default value.
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value), bool> tuple_read_tagged(Tup& tup,
+		const buf_t*& cursor, size_t& fields, const buf_t* end) {
+		typedef std::decay_t<std::tuple_element_t<idx, Tup>> elem_type;
+		while (fields > 0) {
+			if (end - cursor < (std::ptrdiff_t)sizeof(uint16_t))
+				return false;
+			const uint16_t tag = extract<uint16_t>(cursor);
+			const size_t index = tag >> 3;
+			if (index > idx)
+				break;
+			const buf_t* value;
+			size_t value_size;
+			if (!tagged_value(tag, cursor + sizeof(uint16_t), end, value, value_size))
+				return false;
+			cursor = value + value_size;
+			fields--;
+			if (index < idx)
+				continue;
+			if ((tag & 7) != tag_kind<elem_type>() || deserialize_checked(std::get<idx>(tup), value, value_size) != value_size)
+				return false;
+			return tuple_read_tagged<Tup, idx + 1>(tup, cursor, fields, end);
+		}
+		std::get<idx>(tup) = elem_type();
+		return tuple_read_tagged<Tup, idx + 1>(tup, cursor, fields, end);
+	}
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Aligned layout
+	//----------------------------------------------------------------------------------------------
+
+	// Same content as serialize(), with every scalar, structure and element block padded
+	// (zero bytes) to its natural alignment, relative to the message start.
+	// When the receive buffer is aligned (e.g. std::vector or malloc memory), numeric arrays
+	// can then be read in place : decode into serdes::array_view<T> where the writer had a
+	// container of T, or serdes::block_view<T> where it had a fixed size block T.
+	// Supports scalars, structures, containers, std::array, tuples and associative containers.
+	template<typename Tp>
+	static inline size_t aligned_payload_size(const Tp& src) {
+		return aligned_end(0, src);
+	}
+
+	// 'ptr' is the message start and holds aligned_payload_size(src) bytes
+	template<typename Tp>
+	static inline size_t serialize_aligned(ser_dst ptr, const Tp& src) {
+		return aligned_write(ptr, 0, src);
+	}
+
+	template<typename Tp>
+	static inline size_t deserialize_aligned(Tp& dst, deser_src ptr) {
+		return aligned_read(dst, ptr, 0);
+	}
+
+private:
+	static inline constexpr size_t align_up(size_t offset, size_t alignment) {
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Scalars and structures, stored with their memory layout
+	template<typename Tp>
+	static constexpr bool is_aligned_scalar = !is_serdes_special<Tp> && !serdes::is_wire_view_v<Tp>;
+
+	// Elements copied in one block when the byte order does not change
+	template<typename Tp>
+	static constexpr bool is_bulk_copyable = is_aligned_scalar<Tp> && (!big_endian || std::is_floating_point<Tp>::value);
+
+	// Types whose aligned encoding is their memory layout, which views can point to
+	template<typename Tp>
+	struct is_flat : std::integral_constant<bool, is_aligned_scalar<Tp>> {};
+	template<typename V, size_t N>
+	struct is_flat<std::array<V, N>> : is_flat<V> {};
+
+	template<typename Tp>
+	static inline std::enable_if_t<is_aligned_scalar<Tp>, size_t> aligned_end(size_t offset, const Tp&) {
+		return align_up(offset, alignof(Tp)) + sizeof(Tp);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<Tp>, size_t> aligned_end(size_t offset, const Tp& vec) {
+		typedef typename Tp::value_type elem_type;
+		offset = align_up(offset, alignof(uint32_t)) + count_size(vec.size());
+		if (is_aligned_scalar<elem_type>)
+			return vec.empty() ? offset : align_up(offset, alignof(elem_type)) + vec.size() * sizeof(elem_type);
+		for (auto& elem : vec)
+			offset = aligned_end(offset, elem);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<Tp>, size_t> aligned_end(size_t offset, const Tp& arr) {
+		for (auto& elem : arr)
+			offset = aligned_end(offset, elem);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, size_t> aligned_end(size_t offset, const Tp& tup) {
+		return tuple_aligned_end<Tp, 0>(offset, tup);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<Tp>, size_t> aligned_end(size_t offset, const Tp& assoc) {
+		offset = align_up(offset, alignof(uint32_t)) + count_size(assoc.size());
+		for (auto& entry : assoc)
+			offset = aligned_entry_end(offset, entry);
+		return offset;
+	}
+
+	template<typename K, typename V>
+	static inline size_t aligned_entry_end(size_t offset, const std::pair<K, V>& entry) {
+		return aligned_end(aligned_end(offset, entry.first), entry.second);
+	}
+
+	template<typename Tp>
+	static inline size_t aligned_entry_end(size_t offset, const Tp& key) {
+		return aligned_end(offset, key);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), size_t> tuple_aligned_end(size_t offset, const Tup&) {
+		return offset;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value), size_t> tuple_aligned_end(size_t offset, const Tup& tup) {
+		return tuple_aligned_end<Tup, idx + 1>(aligned_end(offset, std::get<idx>(tup)), tup);
+	}
+
+	// Writers return the offset after the value, padding is zeroed
+	static inline size_t aligned_pad(buf_t* base, size_t offset, size_t alignment) {
+		const size_t aligned = align_up(offset, alignment);
+		for (; offset < aligned; offset++)
+			base[offset] = (buf_t)0;
+		return aligned;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<is_aligned_scalar<Tp>, size_t> aligned_write(buf_t* base, size_t offset, const Tp& src) {
+		offset = aligned_pad(base, offset, alignof(Tp));
+		inject(base + offset, src);
+		return offset + sizeof(Tp);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<Tp>, size_t> aligned_write(buf_t* base, size_t offset, const Tp& vec) {
+		typedef typename Tp::value_type elem_type;
+		offset = aligned_pad(base, offset, alignof(uint32_t));
+		offset += inject_count(base + offset, vec.size());
+		if (vec.empty())
+			return offset;
+		if (is_bulk_copyable<elem_type> && std::is_same<std::vector<elem_type>, Tp>::value) {
+			offset = aligned_pad(base, offset, alignof(elem_type));
+			memcpy(base + offset, &*vec.begin(), vec.size() * sizeof(elem_type));
+			return offset + vec.size() * sizeof(elem_type);
+		}
+		for (auto& elem : vec)
+			offset = aligned_write(base, offset, elem);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<Tp>, size_t> aligned_write(buf_t* base, size_t offset, const Tp& arr) {
+		for (auto& elem : arr)
+			offset = aligned_write(base, offset, elem);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, size_t> aligned_write(buf_t* base, size_t offset, const Tp& tup) {
+		return tuple_aligned_write<Tp, 0>(base, offset, tup);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<Tp>, size_t> aligned_write(buf_t* base, size_t offset, const Tp& assoc) {
+		offset = aligned_pad(base, offset, alignof(uint32_t));
+		offset += inject_count(base + offset, assoc.size());
+		for (auto& entry : assoc)
+			offset = aligned_entry_write(base, offset, entry);
+		return offset;
+	}
+
+	template<typename K, typename V>
+	static inline size_t aligned_entry_write(buf_t* base, size_t offset, const std::pair<K, V>& entry) {
+		return aligned_write(base, aligned_write(base, offset, entry.first), entry.second);
+	}
+
+	template<typename Tp>
+	static inline size_t aligned_entry_write(buf_t* base, size_t offset, const Tp& key) {
+		return aligned_write(base, offset, key);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), size_t> tuple_aligned_write(buf_t*, size_t offset, const Tup&) {
+		return offset;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value), size_t> tuple_aligned_write(buf_t* base, size_t offset, const Tup& tup) {
+		return tuple_aligned_write<Tup, idx + 1>(base, aligned_write(base, offset, std::get<idx>(tup)), tup);
+	}
+
+	// Readers return the offset after the value
+	template<typename Tp>
+	static inline std::enable_if_t<is_aligned_scalar<Tp>, size_t> aligned_read(Tp& dst, deser_src base, size_t offset) {
+		offset = align_up(offset, alignof(Tp));
+		dst = extract<Tp>(base + offset);
+		return offset + sizeof(Tp);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<Tp>, size_t> aligned_read(Tp& vec, deser_src base, size_t offset) {
+		typedef typename Tp::value_type elem_type;
+		size_t elem_nums = 0;
+		offset = align_up(offset, alignof(uint32_t));
+		offset += extract_count(base + offset, elem_nums);
+		vec.resize(elem_nums);
+		if (elem_nums == 0)
+			return offset;
+		if (is_bulk_copyable<elem_type> && std::is_same<std::vector<elem_type>, Tp>::value) {
+			offset = align_up(offset, alignof(elem_type));
+			memcpy(&*vec.begin(), base + offset, elem_nums * sizeof(elem_type));
+			return offset + elem_nums * sizeof(elem_type);
+		}
+		for (auto& elem : vec)
+			offset = aligned_read(elem, base, offset);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<Tp>, size_t> aligned_read(Tp& arr, deser_src base, size_t offset) {
+		for (auto& elem : arr)
+			offset = aligned_read(elem, base, offset);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, size_t> aligned_read(Tp& tup, deser_src base, size_t offset) {
+		return tuple_aligned_read<Tp, 0>(tup, base, offset);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<Tp>, size_t> aligned_read(Tp& assoc, deser_src base, size_t offset) {
+		size_t elem_nums = 0;
+		offset = align_up(offset, alignof(uint32_t));
+		offset += extract_count(base + offset, elem_nums);
+		assoc.clear();
+		reserve_entries(assoc, elem_nums);
+		for (size_t i = 0; i < elem_nums; i++)
+			offset = aligned_read_entry(assoc, base, offset);
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::has_mapped_type<Tp>::value, size_t> aligned_read_entry(Tp& assoc, deser_src base, size_t offset) {
+		typename Tp::key_type key{};
+		typename Tp::mapped_type value{};
+		offset = aligned_read(value, base, aligned_read(key, base, offset));
+		assoc.emplace_hint(assoc.end(), std::move(key), std::move(value));
+		return offset;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!serdes::has_mapped_type<Tp>::value, size_t> aligned_read_entry(Tp& assoc, deser_src base, size_t offset) {
+		typename Tp::key_type key{};
+		offset = aligned_read(key, base, offset);
+		assoc.emplace_hint(assoc.end(), std::move(key));
+		return offset;
+	}
+
+	template<typename T>
+	static inline size_t aligned_read(serdes::array_view<T>& view, deser_src base, size_t offset) {
+		static_assert(is_flat<T>::value && !big_endian, "views need elements stored with their memory layout");
+		offset = align_up(offset, alignof(uint32_t));
+		offset += extract_count(base + offset, view.count);
+		if (view.count != 0)
+			offset = align_up(offset, alignof(T));
+		view.ptr = static_cast<const T*>(static_cast<const void*>(base + offset));
+		assert((uintptr_t)view.ptr % alignof(T) == 0 && "unaligned receive buffer");
+		return offset + view.count * sizeof(T);
+	}
+
+	template<typename T>
+	static inline size_t aligned_read(serdes::block_view<T>& view, deser_src base, size_t offset) {
+		static_assert(is_flat<T>::value && !big_endian, "views need elements stored with their memory layout");
+		offset = align_up(offset, alignof(T));
+		view.ptr = static_cast<const T*>(static_cast<const void*>(base + offset));
+		assert((uintptr_t)view.ptr % alignof(T) == 0 && "unaligned receive buffer");
+		return offset + sizeof(T);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), size_t> tuple_aligned_read(Tup&, deser_src, size_t offset) {
+		return offset;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value), size_t> tuple_aligned_read(Tup& tup, deser_src base, size_t offset) {
+		return tuple_aligned_read<Tup, idx + 1>(tup, base, aligned_read(std::get<idx>(tup), base, offset));
+	}
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Checked decoding
+	//----------------------------------------------------------------------------------------------
+
+	// Encoded size of the 'Tp' at 'ptr' when it is well formed and fits in 'size' bytes :
+	// counts within the buffer, bool values, optional flags and variant indexes valid.
+	// Returns 0 otherwise. Use it on untrusted input before deserialize().
+	template<typename Tp>
+	static inline size_t validate(deser_src ptr, size_t size) {
+		static_assert(is_serdesable_v<Tp>, "cannot convert");
+		size_t offset = 0;
+		return checked_skip<std::decay_t<Tp>>(ptr, size, offset) ? offset : 0;
+	}
+
+	// deserialize() of a validated buffer, returns 0 on malformed or truncated input.
+	template<typename Tp>
+	static inline size_t deserialize_checked(Tp& dst, deser_src ptr, size_t size) {
+		const size_t encoded = validate<Tp>(ptr, size);
+		return encoded != 0 && deserialize(dst, ptr) == encoded ? encoded : 0;
+	}
+
+private:
+	// Elements checked by their size only
+	template<typename Tp>
+	static constexpr bool is_checked_block = !is_serdes_special<Tp> && !std::is_same<bool, Tp>::value;
+
+	static inline bool checked_advance(size_t size, size_t& offset, size_t bytes) {
+		if (bytes > size - offset)
+			return false;
+		offset += bytes;
+		return true;
+	}
+
+	static inline bool checked_count(deser_src ptr, size_t size, size_t& offset, size_t& count) {
+		if (sizeof(uint32_t) > size - offset)
+			return false;
+		if (extract<uint32_t>(ptr + offset) == large_count_marker && sizeof(uint32_t) + sizeof(uint64_t) > size - offset)
+			return false;
+		offset += extract_count(ptr + offset, count);
+		return true;
+	}
+
+	// 'count' elements of 'elem_size' bytes
+	static inline bool checked_block(size_t size, size_t& offset, size_t count, size_t elem_size) {
+		if (count > (size - offset) / elem_size)
+			return false;
+		offset += count * elem_size;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp> && !std::is_same<bool, Tp>::value,
+		bool> checked_skip(deser_src, size_t size, size_t& offset) {
+		return checked_advance(size, offset, sizeof(Tp));
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<std::is_same<bool, Tp>::value,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		return offset < size && (uint8_t)ptr[offset] <= 1 && checked_advance(size, offset, sizeof(bool));
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_c_string_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		size_t count = 0;
+		return checked_count(ptr, size, offset, count) && checked_block(size, offset, count, sizeof(char));
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_bit_vector_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		size_t count = 0;
+		if (!checked_count(ptr, size, offset, count) || count / 8 > size - offset)
+			return false;
+		return checked_advance(size, offset, count / 8 + (count % 8 != 0));
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		typedef typename Tp::value_type elem_type;
+		size_t count = 0;
+		if (!checked_count(ptr, size, offset, count))
+			return false;
+		if (is_checked_block<elem_type>)
+			return checked_block(size, offset, count, sizeof(elem_type));
+		if (count > size - offset) // at least a byte per element, so a forged count cannot allocate
+			return false;
+		for (size_t i = 0; i < count; i++)
+			if (!checked_skip<elem_type>(ptr, size, offset))
+				return false;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		typedef typename Tp::value_type elem_type;
+		if (is_checked_block<elem_type>)
+			return checked_advance(size, offset, fixed_size<Tp>());
+		for (size_t i = 0; i < std::tuple_size<Tp>::value; i++)
+			if (!checked_skip<elem_type>(ptr, size, offset))
+				return false;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		return tuple_checked_skip<Tp, 0>(ptr, size, offset);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		size_t count = 0;
+		if (!checked_count(ptr, size, offset, count) || count > size - offset)
+			return false;
+		for (size_t i = 0; i < count; i++)
+			if (!checked_skip_entry<Tp>(ptr, size, offset))
+				return false;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::has_mapped_type<Tp>::value,
+		bool> checked_skip_entry(deser_src ptr, size_t size, size_t& offset) {
+		return checked_skip<typename Tp::key_type>(ptr, size, offset) &&
+			checked_skip<typename Tp::mapped_type>(ptr, size, offset);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!serdes::has_mapped_type<Tp>::value,
+		bool> checked_skip_entry(deser_src ptr, size_t size, size_t& offset) {
+		return checked_skip<typename Tp::key_type>(ptr, size, offset);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		bool> tuple_checked_skip(deser_src, size_t, size_t&) {
+		return true;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		bool> tuple_checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		return checked_skip<std::decay_t<std::tuple_element_t<idx, Tup>>>(ptr, size, offset) &&
+			tuple_checked_skip<Tup, idx + 1>(ptr, size, offset);
+	}
+
+#if __cplusplus >= 201703L
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_optional_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		if (offset >= size || (uint8_t)ptr[offset] > 1)
+			return false;
+		return ptr[offset++] == 0 || checked_skip<typename Tp::value_type>(ptr, size, offset);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_variant_v<Tp>,
+		bool> checked_skip(deser_src ptr, size_t size, size_t& offset) {
+		if (offset >= size || (size_t)(uint8_t)ptr[offset] >= std::variant_size<Tp>::value)
+			return false;
+		return variant_checked_skip<Tp, 0>((size_t)(uint8_t)ptr[offset++], ptr, size, offset);
+	}
+
+	template<class Var, size_t idx>
+	static inline std::enable_if_t<!(idx < std::variant_size<Var>::value),
+		bool> variant_checked_skip(size_t, deser_src, size_t, size_t&) {
+		return false;
+	}
+
+	template<class Var, size_t idx>
+	static inline std::enable_if_t<(idx < std::variant_size<Var>::value),
+		bool> variant_checked_skip(size_t index, deser_src ptr, size_t size, size_t& offset) {
+		if (index != idx)
+			return variant_checked_skip<Var, idx + 1>(index, ptr, size, offset);
+		return checked_skip<std::variant_alternative_t<idx, Var>>(ptr, size, offset);
+	}
+#endif
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Bounded encoding
+	//----------------------------------------------------------------------------------------------
+
+	// serialize() into 'capacity' bytes without a payload_size() pass first.
+	// Returns the encoded size, or 0 when 'src' does not fit (the bytes written so far are unspecified).
+	// Fixed size subtrees are checked once, variable ones element by element.
+	template<typename Tp>
+	static inline size_t serialize_bounded(ser_dst ptr, size_t capacity, const Tp& src) {
+		size_t offset = 0;
+		return bounded_write(ptr, capacity, offset, src) ? offset : 0;
+	}
+
+private:
+	template<typename Tp>
+	static inline bool bounded_copy(ser_dst ptr, size_t capacity, size_t& offset, const Tp& src, size_t size) {
+		if (size > capacity - offset)
+			return false;
+		offset += serialize(ptr + offset, src);
+		return true;
+	}
+
+	static inline bool bounded_count(ser_dst ptr, size_t capacity, size_t& offset, size_t count) {
+		if (count_size(count) > capacity - offset)
+			return false;
+		offset += inject_count(ptr + offset, count);
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_container_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& vec) {
+		typedef typename Tp::value_type elem_type;
+		if (is_fixed_size<elem_type>())
+			return bounded_copy(ptr, capacity, offset, vec, count_size(vec.size()) + vec.size() * fixed_size<elem_type>());
+		if (!bounded_count(ptr, capacity, offset, vec.size()))
+			return false;
+		for (auto& elem : vec)
+			if (!bounded_write(ptr, capacity, offset, elem))
+				return false;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_array_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& arr) {
+		if (is_fixed_size<Tp>())
+			return bounded_copy(ptr, capacity, offset, arr, fixed_size<Tp>());
+		for (auto& elem : arr)
+			if (!bounded_write(ptr, capacity, offset, elem))
+				return false;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& tup) {
+		return tuple_bounded_write<Tp, 0>(ptr, capacity, offset, tup);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_c_string_v<Tp> || serdes::is_bit_vector_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& src) {
+		return bounded_copy(ptr, capacity, offset, src, payload_size(src));
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_associative_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& assoc) {
+		if (entry_fixed_size<Tp>() != 0)
+			return bounded_copy(ptr, capacity, offset, assoc, count_size(assoc.size()) + assoc.size() * entry_fixed_size<Tp>());
+		if (!bounded_count(ptr, capacity, offset, assoc.size()))
+			return false;
+		for (auto& entry : assoc)
+			if (!bounded_write_entry(ptr, capacity, offset, entry))
+				return false;
+		return true;
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!is_serdes_special<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& src) {
+		return bounded_copy(ptr, capacity, offset, src, sizeof(Tp));
+	}
+
+	template<typename K, typename V>
+	static inline bool bounded_write_entry(ser_dst ptr, size_t capacity, size_t& offset, const std::pair<K, V>& entry) {
+		return bounded_write(ptr, capacity, offset, entry.first) && bounded_write(ptr, capacity, offset, entry.second);
+	}
+
+	template<typename Tp>
+	static inline bool bounded_write_entry(ser_dst ptr, size_t capacity, size_t& offset, const Tp& key) {
+		return bounded_write(ptr, capacity, offset, key);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value),
+		bool> tuple_bounded_write(ser_dst, size_t, size_t&, const Tup&) {
+		return true;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value),
+		bool> tuple_bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tup& tup) {
+		return bounded_write(ptr, capacity, offset, std::get<idx>(tup)) &&
+			tuple_bounded_write<Tup, idx + 1>(ptr, capacity, offset, tup);
+	}
+
+#if __cplusplus >= 201703L
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_optional_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& opt) {
+		if (offset == capacity)
+			return false;
+		inject<uint8_t>(ptr + offset++, opt ? (uint8_t)1 : (uint8_t)0);
+		return !opt || bounded_write(ptr, capacity, offset, *opt);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_variant_v<Tp>,
+		bool> bounded_write(ser_dst ptr, size_t capacity, size_t& offset, const Tp& var) {
+		if (var.valueless_by_exception())
+			return bounded_copy(ptr, capacity, offset, var, sizeof(uint8_t));
+		if (offset == capacity)
+			return false;
+		inject<uint8_t>(ptr + offset++, (uint8_t)var.index());
+		return std::visit([&](const auto& alt) { return bounded_write(ptr, capacity, offset, alt); }, var);
+	}
+#endif
+
+public:
+	//----------------------------------------------------------------------------------------------
+	// Bit-packed tuples
+	//----------------------------------------------------------------------------------------------
+
+	// serialize() of a tuple where each run of adjacent bool, serdes::bits<N, T> and std::bitset<N>
+	// elements takes its total bit count rounded up to bytes. Field offsets are computed at compile
+	// time, the first field in the low bits of the first byte. The other elements are encoded as by
+	// serialize(), nested tuples packed the same way.
+	//   std::tuple<bool, bool, serdes::bits<3, mode>, uint32_t, std::bitset<12>> : 1 + 4 + 2 bytes
+	template<typename Tup>
+	static inline size_t packed_payload_size(const Tup& tup) {
+		static_assert(serdes::is_std_tuple_v<Tup>, "packing a tuple");
+		return tuple_packed_size<Tup, 0>(tup);
+	}
+
+	// 'ptr' holds packed_payload_size(tup) bytes
+	template<typename Tup>
+	static inline size_t serialize_packed(ser_dst ptr, const Tup& tup) {
+		static_assert(serdes::is_std_tuple_v<Tup>, "packing a tuple");
+		return tuple_packed_write<Tup, 0>(ptr, tup);
+	}
+
+	template<typename Tup>
+	static inline size_t deserialize_packed(Tup& tup, deser_src ptr) {
+		static_assert(serdes::is_std_tuple_v<Tup>, "packing a tuple");
+		return tuple_packed_read<Tup, 0>(tup, ptr);
+	}
+
+private:
+	// 'width' (<= 64) bits of 'value' at bit 'offset', over zeroed bytes
+	static inline void put_bits(ser_dst ptr, size_t offset, uint64_t value, size_t width) {
+		while (width != 0) {
+			const size_t shift = offset % 8;
+			const size_t nums = std::min<size_t>(8 - shift, width);
+			ptr[offset / 8] = (buf_t)((uint8_t)ptr[offset / 8] | (uint8_t)((value & ((1U << nums) - 1)) << shift));
+			value >>= nums;
+			offset += nums;
+			width -= nums;
+		}
+	}
+
+	static inline uint64_t get_bits(deser_src ptr, size_t offset, size_t width) {
+		uint64_t value = 0;
+		for (size_t done = 0; done < width;) {
+			const size_t shift = offset % 8;
+			const size_t nums = std::min<size_t>(8 - shift, width - done);
+			value |= (uint64_t)(((uint8_t)ptr[offset / 8] >> shift) & ((1U << nums) - 1)) << done;
+			offset += nums;
+			done += nums;
+		}
+		return value;
+	}
+
+	static inline void put_field(ser_dst ptr, size_t offset, bool src) {
+		put_bits(ptr, offset, src ? 1 : 0, 1);
+	}
+
+	template<size_t width, typename Tp>
+	static inline void put_field(ser_dst ptr, size_t offset, const serdes::bits<width, Tp>& src) {
+		const uint64_t mask = width == 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1;
+		assert((std::is_signed<typename bits_integer<Tp>::type>::value || ((uint64_t)src.value & ~mask) == 0) &&
+			"value wider than its bits");
+		put_bits(ptr, offset, (uint64_t)src.value & mask, width);
+	}
+
+	template<size_t N>
+	static inline void put_field(ser_dst ptr, size_t offset, const std::bitset<N>& src) {
+		for (size_t i = 0; i < N; i++)
+			if (src.test(i))
+				put_bits(ptr, offset + i, 1, 1);
+	}
+
+	static inline void get_field(deser_src ptr, size_t offset, bool& dst) {
+		dst = get_bits(ptr, offset, 1) != 0;
+	}
+
+	template<size_t width, typename Tp>
+	static inline void get_field(deser_src ptr, size_t offset, serdes::bits<width, Tp>& dst) {
+		uint64_t value = get_bits(ptr, offset, width);
+		if (std::is_signed<typename bits_integer<Tp>::type>::value && width < 64 && ((value >> (width - 1)) & 1))
+			value |= ~(uint64_t)0 << (width % 64); // sign extension
+		dst.value = (Tp)value;
+	}
+
+	template<size_t N>
+	static inline void get_field(deser_src ptr, size_t offset, std::bitset<N>& dst) {
+		for (size_t i = 0; i < N; i++)
+			dst.set(i, get_bits(ptr, offset + i, 1) != 0);
+	}
+
+	// Integer type of an integer or enum, for its sign
+	template<typename Tp, bool is_enum = std::is_enum<Tp>::value>
+	struct bits_integer {
+		typedef Tp type;
+	};
+
+	template<typename Tp>
+	struct bits_integer<Tp, true> {
+		typedef std::underlying_type_t<Tp> type;
+	};
+
+	// Fields of the run starting at 'idx', at bit 'offset'
+	template<class Tup, size_t idx, size_t offset>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value == 0> tuple_put_run(ser_dst, const Tup&) {}
+
+	template<class Tup, size_t idx, size_t offset>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value != 0> tuple_put_run(ser_dst ptr, const Tup& tup) {
+		put_field(ptr, offset, std::get<idx>(tup));
+		tuple_put_run<Tup, idx + 1, offset + serdes::tuple_bit_width<Tup, idx>::value>(ptr, tup);
+	}
+
+	template<class Tup, size_t idx, size_t offset>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value == 0> tuple_get_run(deser_src, Tup&) {}
+
+	template<class Tup, size_t idx, size_t offset>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value != 0> tuple_get_run(deser_src ptr, Tup& tup) {
+		get_field(ptr, offset, std::get<idx>(tup));
+		tuple_get_run<Tup, idx + 1, offset + serdes::tuple_bit_width<Tup, idx>::value>(ptr, tup);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, size_t> packed_element_size(const Tp& src) {
+		return packed_payload_size(src);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!serdes::is_std_tuple_v<Tp>, size_t> packed_element_size(const Tp& src) {
+		return payload_size(src);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, size_t> packed_element_write(ser_dst ptr, const Tp& src) {
+		return serialize_packed(ptr, src);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!serdes::is_std_tuple_v<Tp>, size_t> packed_element_write(ser_dst ptr, const Tp& src) {
+		return serialize(ptr, src);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<serdes::is_std_tuple_v<Tp>, size_t> packed_element_read(Tp& dst, deser_src ptr) {
+		return deserialize_packed(dst, ptr);
+	}
+
+	template<typename Tp>
+	static inline std::enable_if_t<!serdes::is_std_tuple_v<Tp>, size_t> packed_element_read(Tp& dst, deser_src ptr) {
+		return deserialize(dst, ptr);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), size_t> tuple_packed_size(const Tup&) {
+		return 0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value) && serdes::tuple_bit_width<Tup, idx>::value == 0,
+		size_t> tuple_packed_size(const Tup& tup) {
+		return packed_element_size(std::get<idx>(tup)) + tuple_packed_size<Tup, idx + 1>(tup);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value != 0,
+		size_t> tuple_packed_size(const Tup& tup) {
+		typedef serdes::bit_run<Tup, idx> run;
+		return (run::bits + 7) / 8 + tuple_packed_size<Tup, idx + run::fields>(tup);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), size_t> tuple_packed_write(ser_dst, const Tup&) {
+		return 0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value) && serdes::tuple_bit_width<Tup, idx>::value == 0,
+		size_t> tuple_packed_write(ser_dst ptr, const Tup& tup) {
+		const size_t cursor = packed_element_write(ptr, std::get<idx>(tup));
+		return cursor + tuple_packed_write<Tup, idx + 1>(ptr + cursor, tup);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value != 0,
+		size_t> tuple_packed_write(ser_dst ptr, const Tup& tup) {
+		typedef serdes::bit_run<Tup, idx> run;
+		constexpr size_t bytes = (run::bits + 7) / 8;
+		std::fill(ptr, ptr + bytes, (buf_t)0);
+		tuple_put_run<Tup, idx, 0>(ptr, tup);
+		return bytes + tuple_packed_write<Tup, idx + run::fields>(ptr + bytes, tup);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<!(idx < std::tuple_size<Tup>::value), size_t> tuple_packed_read(Tup&, deser_src) {
+		return 0;
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<(idx < std::tuple_size<Tup>::value) && serdes::tuple_bit_width<Tup, idx>::value == 0,
+		size_t> tuple_packed_read(Tup& tup, deser_src ptr) {
+		const size_t cursor = packed_element_read(std::get<idx>(tup), ptr);
+		return cursor + tuple_packed_read<Tup, idx + 1>(tup, ptr + cursor);
+	}
+
+	template<class Tup, size_t idx>
+	static inline std::enable_if_t<serdes::tuple_bit_width<Tup, idx>::value != 0,
+		size_t> tuple_packed_read(Tup& tup, deser_src ptr) {
+		typedef serdes::bit_run<Tup, idx> run;
+		tuple_get_run<Tup, idx, 0>(ptr, tup);
+		return (run::bits + 7) / 8 + tuple_packed_read<Tup, idx + run::fields>(tup, ptr + (run::bits + 7) / 8);
+	}
+
+public:
+
+
+	// require c++20 
+	//		GCC 9.0.0	: 201709L. for C++2a.
+	//		Clang 8.0.0	: 201707L.
+	//		VC++ 15.9.3	: 201704L.
+#if __cplusplus > 201703L && (defined(__GNUC__) ? __GNUC__ > 8 : true)
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_container_v<std::decay_t<Tp>>,
+		size_t> elem_nums() {
+		return elem_nums<Tp::value_type>();
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_array_v<std::decay_t<Tp>>,
+		size_t> elem_nums() {
+		return elem_nums<Tp::value_type>() * std::tuple_size<Tp>::value;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_std_tuple_v<std::decay_t<Tp>>,
+		size_t> elem_nums() {
+		return tuple_elem_nums<Tp>();
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<serdes::is_c_string_v<std::decay_t<Tp>>,
+		size_t> elem_nums() {
+		return (size_t)1;
+	}
+
+	template<typename Tp>
+	static inline constexpr std::enable_if_t<!is_serdes_special<Tp>,
+		size_t> elem_nums() {
+		return (size_t)1;
+	}
+
+	template<class Tup, size_t idx>
+	static inline constexpr std::enable_if_t<
+		serdes::is_std_tuple_v<Tup> &&
+		!(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_elem_nums() {
+		// do notting
+		return (size_t)0;
+	}
+
+	template<class Tup, size_t idx = 0>
+	static inline constexpr std::enable_if_t<
+		serdes::is_std_tuple_v<Tup> &&
+		(idx < std::tuple_size<Tup>::value),
+		size_t> tuple_elem_nums() {
+		return elem_nums<std::tuple_element<idx, Tup>::type>() + tuple_elem_nums<Tup, idx + 1>();
+	}
+
+#endif
+};
+
+typedef SerDes<uint8_t, false> SerDesLittle;
+typedef SerDes<uint8_t, true> SerDesBig;
+
+#pragma pack(push, 1) 
+typedef struct length_header {
+	static constexpr int length_bits = 24;
+	static constexpr int checksum_bits = 8;
 	static constexpr uint32_t checksum_mask = (1 << checksum_bits) - 1;
 	static constexpr uint32_t max_packet_size = (1 << length_bits) - 1;
 	static_assert((length_bits + checksum_bits) == (sizeof(uint32_t) * 8), "not matching bit width");
 
+	// Payloads of extended_length or more are framed with extended_header_type.
+	// The length field holds extended_length and the checksum covers the following 64bit length.
+	static constexpr uint32_t extended_length = max_packet_size;
+
 	length_header() = default;
 
 	length_header(uint32_t size)
 		: length(size)
 		, checksum(cal_checksum(size)) {}
 
+	// A compressed payload is flagged by the complemented checksum, check() fails on it.
+	// Receivers without decompression support reject it as a checksum error.
+	length_header(uint32_t size, bool compressed)
+		: length(size)
+		, checksum(compressed ? cal_checksum(size) ^ checksum_mask : cal_checksum(size)) {}
+
 #ifdef __GNUC__ 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wcast-align"
@@ -738,22 +3391,308 @@ typedef struct length_header {
 			(size >> (checksum_bits * 2))) & checksum_mask;
 	}
 
+	static inline uint32_t cal_checksum64(uint64_t size) {
+		uint64_t sum = 0;
+		for (int i = 0; i < 8; i++)
+			sum += size >> (checksum_bits * i);
+		return (uint32_t)(sum & checksum_mask);
+	}
+
+	static inline length_header extended(uint64_t size, bool compressed = false) {
+		length_header header;
+		header.length = extended_length;
+		header.checksum = compressed ? cal_checksum64(size) ^ checksum_mask : cal_checksum64(size);
+		return header;
+	}
+
+	bool is_extended() const {
+		return length == extended_length;
+	}
+
 	bool check() {
 		return checksum == cal_checksum(length);
 	}
 
+	bool is_compressed() {
+		return checksum == (cal_checksum(length) ^ checksum_mask);
+	}
+
+	// check() and is_compressed() for extended headers
+	bool check(uint64_t size) {
+		return checksum == cal_checksum64(size);
+	}
+
+	bool is_compressed(uint64_t size) {
+		return checksum == (cal_checksum64(size) ^ checksum_mask);
+	}
+
 	uint32_t length : length_bits;
 	uint32_t checksum : checksum_bits;
 } length_header_t;
 #pragma pack(pop)
 
 typedef std::tuple<length_header_t, uint16_t, uint16_t> header_type;
+typedef std::tuple<length_header_t, uint64_t, uint16_t, uint16_t> extended_header_type;
+
+// Fragment of a command frame : header_type fields + message id, total frame size, offset
+typedef std::tuple<length_header_t, uint16_t, uint16_t, uint32_t, uint64_t, uint64_t> fragment_header_type;
+static constexpr uint16_t fragment_class_id = 0xFFFF;
+static constexpr size_t fragment_header_size = sizeof(header_type) + sizeof(uint32_t) + sizeof(uint64_t) * 2;
+
+//--------------------------------------------------------------------------------------------------
+// Block compression
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+namespace lz {
+
+	// Self-contained LZ4 block format codec.
+	// A block is a list of sequences: token(literal length:4, match length:4), literals,
+	// 16bit little endian offset, and extended lengths in runs of 255.
+	static constexpr size_t min_match = 4;
+	static constexpr size_t last_literals = 5;
+	static constexpr size_t match_find_limit = 12;
+	static constexpr size_t max_offset = 0xFFFF;
+	static constexpr int hash_log = 12;
+
+	inline size_t compress_bound(size_t src_size) {
+		return src_size + (src_size / 255) + 16;
+	}
+
+	// Largest output of a block of src_size bytes : a length byte of 255 adds 255 bytes.
+	inline uint64_t decompress_bound(size_t src_size) {
+		return (uint64_t)src_size * 255 + 16;
+	}
+
+	inline uint32_t read32(const uint8_t* ptr) {
+		uint32_t val;
+		memcpy(&val, ptr, sizeof(val));
+		return val;
+	}
+
+	inline uint32_t hash32(uint32_t seq) {
+		return (seq * 2654435761U) >> (32 - hash_log);
+	}
+
+	inline uint8_t* write_length(uint8_t* op, size_t len) {
+		for (; len >= 255; len -= 255)
+			*op++ = 255;
+		*op++ = (uint8_t)len;
+		return op;
+	}
+
+	inline uint8_t* write_sequence(uint8_t* op, const uint8_t* const oend,
+		const uint8_t* literal, size_t literal_len, size_t offset, size_t match_len) {
+		const size_t worst = 1 + literal_len + (literal_len / 255) + 1 + 2 + (match_len / 255) + 1;
+		if ((size_t)(oend - op) < worst)
+			return nullptr;
+
+		uint8_t* token = op++;
+		if (literal_len >= 15) {
+			*token = 15 << 4;
+			op = write_length(op, literal_len - 15);
+		}
+		else
+			*token = (uint8_t)(literal_len << 4);
+		memcpy(op, literal, literal_len);
+		op += literal_len;
+
+		if (match_len == 0) // last literals
+			return op;
+
+		*op++ = (uint8_t)(offset & 0xFF);
+		*op++ = (uint8_t)(offset >> 8);
+		match_len -= min_match;
+		if (match_len >= 15) {
+			*token |= 15;
+			op = write_length(op, match_len - 15);
+		}
+		else
+			*token |= (uint8_t)match_len;
+		return op;
+	}
+
+	// Returns compressed size, or 0 when the result does not fit in dst_capacity.
+	inline size_t compress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_capacity) {
+		const uint8_t* const iend = src + src_size;
+		const uint8_t* const oend = dst + dst_capacity;
+		const uint8_t* anchor = src;
+		uint8_t* op = dst;
+
+		if (src_size > match_find_limit) {
+			const uint8_t* const mflimit = iend - match_find_limit;
+			const uint8_t* const matchlimit = iend - last_literals;
+			uint32_t table[1 << hash_log] = { 0, };
+			const uint8_t* ip = src + 1;
+
+			while (ip < mflimit) {
+				const uint32_t h = hash32(read32(ip));
+				const uint8_t* ref = src + table[h];
+				table[h] = (uint32_t)(ip - src);
+				if ((size_t)(ip - ref) > max_offset || read32(ref) != read32(ip)) {
+					ip += 1 + ((ip - anchor) >> 6); // skip faster through incompressible data
+					continue;
+				}
+
+				while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+					ip--;
+					ref--;
+				}
+
+				size_t match_len = min_match;
+				while (ip + match_len < matchlimit && ip[match_len] == ref[match_len])
+					match_len++;
+
+				op = write_sequence(op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), match_len);
+				if (!op)
+					return 0;
+
+				ip += match_len;
+				anchor = ip;
+				if (ip < mflimit)
+					table[hash32(read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+			}
+		}
+
+		op = write_sequence(op, oend, anchor, (size_t)(iend - anchor), 0, 0);
+		return op ? (size_t)(op - dst) : 0;
+	}
+
+	inline bool read_length(const uint8_t*& ip, const uint8_t* const iend, size_t& len) {
+		uint8_t s;
+		do {
+			if (ip >= iend)
+				return false;
+			s = *ip++;
+			len += s;
+		} while (s == 255);
+		return true;
+	}
+
+	// Decodes a whole block, every read and write is bounds checked.
+	// Returns false unless exactly dst_size bytes were produced.
+	inline bool decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+		const uint8_t* ip = src;
+		const uint8_t* const iend = src + src_size;
+		uint8_t* op = dst;
+		uint8_t* const oend = dst + dst_size;
+
+		while (ip < iend) {
+			const uint8_t token = *ip++;
+
+			size_t literal_len = token >> 4;
+			if (literal_len == 15 && !read_length(ip, iend, literal_len))
+				return false;
+			if (literal_len > (size_t)(iend - ip) || literal_len > (size_t)(oend - op))
+				return false;
+			memcpy(op, ip, literal_len);
+			ip += literal_len;
+			op += literal_len;
+
+			if (ip == iend) // last literals
+				break;
+
+			if (iend - ip < 2)
+				return false;
+			const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+			ip += 2;
+			if (offset == 0 || offset > (size_t)(op - dst))
+				return false;
+
+			size_t match_len = token & 15;
+			if (match_len == 15 && !read_length(ip, iend, match_len))
+				return false;
+			match_len += min_match;
+			if (match_len > (size_t)(oend - op))
+				return false;
+
+			const uint8_t* ref = op - offset;
+			if (offset >= match_len)
+				memcpy(op, ref, match_len);
+			else // overlapped copy
+				for (size_t i = 0; i < match_len; i++)
+					op[i] = ref[i];
+			op += match_len;
+		}
+		return op == oend;
+	}
+
+} // namespace lz
+} // namespace serdes
+
+//--------------------------------------------------------------------------------------------------
+// Instrumentation
+//--------------------------------------------------------------------------------------------------
+
+namespace serdes {
+
+	// Statistics policy of DynamicSerDes and InstrumentedSerDes. Hooks receive the top-level type,
+	// the command key, the encoded size, the elapsed time (now() difference) and the number of
+	// buffer reallocations. The default policy is disabled and compiles to nothing,
+	// see serdes_stats.hpp for per-thread counters.
+	struct no_stats {
+		static constexpr bool enabled = false;
+
+		static inline constexpr uint64_t now() { return 0; }
+
+		template<typename Tp>
+		static inline void on_encode(uint32_t, size_t, uint64_t, size_t) {}
+
+		template<typename Tp>
+		static inline void on_decode(uint32_t, size_t, uint64_t, size_t) {}
+	};
+
+	static constexpr uint32_t no_command = 0xFFFFFFFF; // SerDes calls outside of a command frame
+
+	inline constexpr uint32_t command_key(uint16_t class_id, uint16_t func_id) {
+		return ((uint32_t)class_id << 16) | func_id;
+	}
+
+	// std::tuple<const int&, ...> -> std::tuple<int, ...>, so references and values share their statistics
+	template<typename Tup>
+	struct decay_tuple {
+		typedef std::decay_t<Tup> type;
+	};
+
+	template<typename... Ts>
+	struct decay_tuple<std::tuple<Ts...>> {
+		typedef std::tuple<std::decay_t<Ts>...> type;
+	};
+
+	template<typename Tup>
+	using decay_tuple_t = typename decay_tuple<std::decay_t<Tup>>::type;
+
+} // namespace serdes
+
+// SerDes reporting its top-level serialize / deserialize calls to 'stats_policy'.
+template<typename stats_policy, typename buf_t = uint8_t, bool big_endian = false>
+class InstrumentedSerDes : public SerDes<buf_t, big_endian> {
+	typedef SerDes<buf_t, big_endian> serdes_type;
+public:
+	template<typename Tp>
+	static inline size_t serialize(buf_t* const __restrict ptr, const Tp& src) {
+		const uint64_t start = stats_policy::now();
+		const size_t size = serdes_type::serialize(ptr, src);
+		if (stats_policy::enabled)
+			stats_policy::template on_encode<serdes::decay_tuple_t<Tp>>(serdes::no_command, size, stats_policy::now() - start, 0);
+		return size;
+	}
+
+	template<typename Tp>
+	static inline size_t deserialize(Tp& dst, const buf_t* const __restrict ptr) {
+		const uint64_t start = stats_policy::now();
+		const size_t size = serdes_type::deserialize(dst, ptr);
+		if (stats_policy::enabled)
+			stats_policy::template on_decode<serdes::decay_tuple_t<Tp>>(serdes::no_command, size, stats_policy::now() - start, 0);
+		return size;
+	}
+};
 
 //--------------------------------------------------------------------------------------------------
 // Commands serializer
 //--------------------------------------------------------------------------------------------------
 
-template<typename buf_t = uint8_t, bool big_endian = false>
+template<typename buf_t = uint8_t, bool big_endian = false, typename stats_policy = serdes::no_stats>
 class DynamicSerDes {
 private:
 
@@ -765,15 +3704,150 @@ private:
 		return build_command<class_id, func_id>(buffer, std::get<I>(tup_args)...);
 	}
 
+	static inline constexpr size_t header_size(uint64_t payload_size) {
+		return payload_size < length_header_t::extended_length ?
+			sizeof(header_type) : sizeof(length_header_t) + sizeof(uint64_t) + sizeof(uint16_t) * 2;
+	}
+
+	template<uint16_t class_id, uint16_t func_id>
+	static inline size_t write_header(buf_t* ptr, uint64_t payload_size, bool compressed) {
+		if (payload_size < length_header_t::extended_length)
+			return SerDes<buf_t, big_endian>::serialize(ptr,
+				header_type(length_header_t((uint32_t)payload_size, compressed), class_id, func_id));
+		return SerDes<buf_t, big_endian>::serialize(ptr,
+			extended_header_type(length_header_t::extended(payload_size, compressed), payload_size, class_id, func_id));
+	}
+
+	// Frames are written at 'base', after the existing content of 'buffer'.
+	template<uint16_t class_id, uint16_t func_id, typename Tup>
+	inline size_t append_frame(std::vector<buf_t>& buffer, const size_t base, const Tup& all_arg) {
+		if (!stats_policy::enabled)
+			return encode_frame<class_id, func_id>(buffer, base, all_arg);
+		const uint64_t start = stats_policy::now();
+		const size_t capacity = buffer.capacity();
+		const size_t scratch_capacity = scratch.capacity();
+		const size_t size = encode_frame<class_id, func_id>(buffer, base, all_arg);
+		stats_policy::template on_encode<serdes::decay_tuple_t<Tup>>(serdes::command_key(class_id, func_id), size,
+			stats_policy::now() - start, (buffer.capacity() != capacity) + (scratch.capacity() != scratch_capacity));
+		return size;
+	}
+
+	template<uint16_t class_id, uint16_t func_id, typename Tup>
+	inline size_t encode_frame(std::vector<buf_t>& buffer, const size_t base, const Tup& all_arg) {
+		size_t* hint = nullptr;
+		if (size_hinting) {
+			hint = &size_hints[serdes::command_key(class_id, func_id)];
+			const size_t size = encode_hinted<class_id, func_id>(buffer, base, all_arg, *hint);
+			if (size != 0)
+				return size;
+		}
+		const size_t all_arg_size = SerDes<buf_t, big_endian>::payload_size(all_arg);
+		if (hint)
+			learn_size(*hint, all_arg_size);
+		if (all_arg_size >= compress_threshold && (uint64_t)all_arg_size <= UINT32_MAX)
+			return append_compressed_frame<class_id, func_id>(buffer, base, all_arg, all_arg_size);
+		const size_t hdr_size = header_size(all_arg_size);
+		buffer.resize(base + hdr_size + all_arg_size);
+		write_header<class_id, func_id>(buffer.data() + base, all_arg_size, false);
+		return hdr_size + SerDes<buf_t, big_endian>::serialize(buffer.data() + base + hdr_size, all_arg);
+	}
+
+	template<uint16_t class_id, uint16_t func_id, typename Tup>
+	inline size_t append_compressed_frame(std::vector<buf_t>& buffer, const size_t base,
+		const Tup& all_arg, const size_t all_arg_size) {
+		scratch.resize(all_arg_size);
+		SerDes<buf_t, big_endian>::serialize(scratch.data(), all_arg);
+
+		// compressed payload : raw size(uint32_t) + lz block
+		constexpr size_t raw_size_bytes = sizeof(uint32_t);
+		const size_t max_header_size = header_size(length_header_t::extended_length);
+		buffer.resize(base + max_header_size + raw_size_bytes + serdes::lz::compress_bound(all_arg_size));
+		buf_t* frame = buffer.data() + base;
+		const size_t block_size = serdes::lz::compress(
+			(const uint8_t*)scratch.data(), all_arg_size,
+			(uint8_t*)frame + max_header_size + raw_size_bytes, all_arg_size);
+
+		if (block_size == 0 || all_arg_size <= raw_size_bytes || block_size >= all_arg_size - raw_size_bytes) { // incompressible
+			const size_t hdr_size = header_size(all_arg_size);
+			buffer.resize(base + hdr_size + all_arg_size);
+			memcpy(frame + hdr_size, scratch.data(), all_arg_size);
+			return write_header<class_id, func_id>(frame, all_arg_size, false) + all_arg_size;
+		}
+
+		const size_t payload = raw_size_bytes + block_size;
+		const size_t hdr_size = header_size(payload);
+		if (hdr_size != max_header_size)
+			memmove(frame + hdr_size + raw_size_bytes,
+				frame + max_header_size + raw_size_bytes, block_size);
+		buffer.resize(base + hdr_size + payload);
+		write_header<class_id, func_id>(frame, payload, true);
+		SerDes<buf_t, big_endian>::inject(frame + hdr_size, (uint32_t)all_arg_size);
+		return hdr_size + payload;
+	}
+
+	// Encodes straight into 'hint' bytes plus headroom, without the payload_size() pass.
+	// Returns 0 when there is no hint yet, or the payload outgrew it or has to be compressed.
+	template<uint16_t class_id, uint16_t func_id, typename Tup>
+	inline size_t encode_hinted(std::vector<buf_t>& buffer, const size_t base, const Tup& all_arg, size_t& hint) {
+		const size_t capacity = hint + hint / 8;
+		if (hint == 0 || capacity >= length_header_t::extended_length)
+			return 0;
+		constexpr size_t hdr_size = sizeof(header_type);
+		buffer.resize(base + hdr_size + capacity);
+		const size_t all_arg_size = SerDes<buf_t, big_endian>::serialize_bounded(buffer.data() + base + hdr_size, capacity, all_arg);
+		if (all_arg_size == 0 || all_arg_size >= compress_threshold)
+			return 0;
+		learn_size(hint, all_arg_size);
+		buffer.resize(base + hdr_size + all_arg_size);
+		write_header<class_id, func_id>(buffer.data() + base, all_arg_size, false);
+		return hdr_size + all_arg_size;
+	}
+
+	// Exponentially decaying max : follows growth at once, shrinks by 1/16 per message.
+	static inline void learn_size(size_t& hint, size_t size) {
+		hint = std::max(size, hint - hint / 16);
+	}
+
+	std::vector<buf_t> scratch;
+	size_t compress_threshold = no_compress;
+	size_t max_raw_size = default_max_decompressed_size;
+	bool size_hinting = false;
+	std::unordered_map<uint32_t, size_t> size_hints; // payload size per command_key()
+
 public:
+	static constexpr size_t no_compress = (size_t)-1;
+	static constexpr size_t default_max_decompressed_size = (size_t)1 << 26;
+
+	// Payloads of at least 'threshold' bytes are compressed (no_compress : disabled).
+	inline void set_compress_threshold(size_t threshold) {
+		compress_threshold = threshold;
+	}
+
+	// parse_command() rejects compressed frames announcing a larger raw payload.
+	inline void set_max_decompressed_size(size_t max_size) {
+		max_raw_size = max_size;
+	}
+
+	// Learns the payload size of every command and encodes the next ones into a buffer
+	// of that size, skipping the payload_size() pass. A payload larger than the hint
+	// is encoded again the usual way and raises the hint.
+	inline void set_size_hints(bool enable) {
+		size_hinting = enable;
+		size_hints.clear();
+	}
+
+	// Learned payload size of a command, 0 when unknown.
+	inline size_t size_hint(uint16_t class_id, uint16_t func_id) const {
+		auto it = size_hints.find(serdes::command_key(class_id, func_id));
+		return it != size_hints.end() ? it->second : 0;
+	}
+
+	// Payloads of length_header_t::extended_length bytes or more get an extended_header_type.
 	template<uint16_t class_id, uint16_t func_id, typename Tp0, typename... Args>
 	inline typename std::enable_if_t<0 <= sizeof...(Args) && !serdes::is_std_tuple_v<typename std::remove_reference<Tp0>::type>,
 		size_t> build_command(std::vector<buf_t>& buffer, Tp0&& arg0, Args&&... args) {
 		auto all_arg = std::tuple_cat(std::forward_as_tuple(arg0), std::forward_as_tuple(args)...);
-		const size_t all_arg_size = SerDes<buf_t, big_endian>::payload_size(all_arg);
-		buffer.resize(sizeof(header_type) + all_arg_size);
-		return SerDes<buf_t, big_endian>::serialize(buffer.data(),
-			std::tuple_cat(std::make_tuple(length_header_t((uint32_t)all_arg_size), class_id, func_id), all_arg));
+		return append_frame<class_id, func_id>(buffer, 0, all_arg);
 	}
 
 	template<uint16_t class_id, uint16_t func_id, typename... Args>
@@ -791,6 +3865,360 @@ public:
 			std::index_sequence_for<Args...>{}, tup_args);
 	}
 
+	// Appends a frame after the existing content of 'buffer' (e.g. batching several commands).
+	// A single tuple argument is encoded the same as its unpacked elements.
+	// Returns the appended frame size.
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	inline size_t append_command(std::vector<buf_t>& buffer, Args&&... args) {
+		return append_frame<class_id, func_id>(buffer, buffer.size(), std::forward_as_tuple(args...));
+	}
+
+	// Size of the uncompressed frame of 'args', for writing into caller provided memory.
+	template<typename... Args>
+	static inline size_t command_size(const Args&... args) {
+		const uint64_t payload_size = SerDes<buf_t, big_endian>::payload_size(std::forward_as_tuple(args...));
+		return header_size(payload_size) + (size_t)payload_size;
+	}
+
+	// Writes an uncompressed frame into 'ptr' holding command_size(args...) bytes.
+	template<uint16_t class_id, uint16_t func_id, typename... Args>
+	static inline size_t write_command(buf_t* ptr, const Args&... args) {
+		const uint64_t start = stats_policy::now();
+		auto all_arg = std::forward_as_tuple(args...);
+		const size_t all_arg_size = SerDes<buf_t, big_endian>::payload_size(all_arg);
+		const size_t hdr_size = write_header<class_id, func_id>(ptr, all_arg_size, false);
+		const size_t size = hdr_size + SerDes<buf_t, big_endian>::serialize(ptr + hdr_size, all_arg);
+		if (stats_policy::enabled)
+			stats_policy::template on_encode<std::tuple<Args...>>(serdes::command_key(class_id, func_id), size,
+				stats_policy::now() - start, 0);
+		return size;
+	}
+
+	// Header of an uncompressed frame whose payload is written piecewise by the caller.
+	// 'ptr' holds command_header_size(payload_size) bytes.
+	static inline constexpr size_t command_header_size(uint64_t payload_size) {
+		return header_size(payload_size);
+	}
+
+	template<uint16_t class_id, uint16_t func_id>
+	static inline size_t write_command_header(buf_t* ptr, uint64_t payload_size) {
+		return write_header<class_id, func_id>(ptr, payload_size, false);
+	}
+
+	// Size of the frame at 'frame' (header + payload). Returns 0 when the header is corrupted
+	// or 'available' bytes do not hold the whole frame.
+	static inline size_t frame_size(const buf_t* frame, size_t available) {
+		if (available < sizeof(header_type))
+			return 0;
+		length_header_t len_header;
+		SerDes<buf_t, big_endian>::deserialize(len_header, frame);
+		if (len_header.is_extended() && available < header_size(length_header_t::extended_length))
+			return 0;
+		extended_header_type header;
+		bool compressed;
+		const size_t hdr_size = read_header(frame, header, compressed);
+		if (hdr_size == 0 || std::get<1>(header) > available - hdr_size)
+			return 0;
+		return hdr_size + (size_t)std::get<1>(header);
+	}
+
+	// Reads the frame header. Returns false on checksum mismatch.
+	static inline bool parse_header(const buf_t* frame, header_type& header) {
+		SerDes<buf_t, big_endian>::deserialize(header, frame);
+		return std::get<0>(header).check();
+	}
+
+	// Reads a standard or extended frame header, std::get<1> is the payload length for both.
+	// Returns the header size, or 0 on checksum mismatch (a compressed frame included).
+	static inline size_t parse_header(const buf_t* frame, extended_header_type& header) {
+		bool compressed;
+		const size_t hdr_size = read_header(frame, header, compressed);
+		return compressed ? 0 : hdr_size;
+	}
+
+	static inline bool is_compressed(extended_header_type& header) {
+		length_header_t& len_header = std::get<0>(header);
+		return len_header.is_extended() ? len_header.is_compressed(std::get<1>(header)) : len_header.is_compressed();
+	}
+
+	// Decodes the arguments of a frame built by build_command, decompressing if flagged.
+	// The decompression buffer is kept between calls, so steady state decoding does not allocate.
+	// Returns the consumed frame size, or 0 on a malformed frame or when 'available' bytes
+	// do not hold the whole frame. The payload is decoded with deserialize_checked.
+	template<typename Tup>
+	inline size_t parse_command(const buf_t* frame, size_t available, Tup& args) {
+		if (available < sizeof(header_type))
+			return 0;
+		length_header_t len_header;
+		SerDes<buf_t, big_endian>::deserialize(len_header, frame);
+		if (len_header.is_extended() && available < header_size(length_header_t::extended_length))
+			return 0;
+		return decode_command(frame, available, args);
+	}
+
+	// Same, for a frame known to be whole (delimited by frame_size(), a queue slot, a record...) :
+	// the payload length of the header is trusted, the payload itself is still checked.
+	template<typename Tup>
+	inline size_t parse_command(const buf_t* frame, Tup& args) {
+		return decode_command(frame, (size_t)-1, args);
+	}
+
+private:
+	template<typename Tup>
+	inline size_t decode_command(const buf_t* frame, size_t available, Tup& args) {
+		if (!stats_policy::enabled)
+			return decode_frame(frame, available, args);
+		const uint64_t start = stats_policy::now();
+		const size_t scratch_capacity = scratch.capacity();
+		const size_t size = decode_frame(frame, available, args);
+		const uint64_t elapsed = stats_policy::now() - start;
+		extended_header_type header;
+		bool compressed;
+		if (size != 0 && read_header(frame, header, compressed) != 0)
+			stats_policy::template on_decode<serdes::decay_tuple_t<Tup>>(serdes::command_key(std::get<2>(header), std::get<3>(header)),
+				size, elapsed, scratch.capacity() != scratch_capacity);
+		return size;
+	}
+
+	// parse_header() that also accepts the compressed flag, for frame_size() and parse_command().
+	static inline size_t read_header(const buf_t* frame, extended_header_type& header, bool& compressed) {
+		length_header_t len_header;
+		SerDes<buf_t, big_endian>::deserialize(len_header, frame);
+		size_t hdr_size = sizeof(header_type);
+		if (!len_header.is_extended()) {
+			header_type std_header;
+			SerDes<buf_t, big_endian>::deserialize(std_header, frame);
+			header = extended_header_type(std::get<0>(std_header), (uint64_t)std::get<0>(std_header).length,
+				std::get<1>(std_header), std::get<2>(std_header));
+		}
+		else
+			hdr_size = SerDes<buf_t, big_endian>::deserialize(header, frame);
+		compressed = is_compressed(header);
+		const bool plain = len_header.is_extended() ? std::get<0>(header).check(std::get<1>(header)) : std::get<0>(header).check();
+		return plain || compressed ? hdr_size : 0;
+	}
+
+	template<typename Tup>
+	inline size_t decode_frame(const buf_t* frame, size_t available, Tup& args) {
+		extended_header_type header;
+		bool compressed;
+		const size_t hdr_size = read_header(frame, header, compressed);
+		if (hdr_size == 0 || std::get<1>(header) > available - hdr_size)
+			return 0;
+		const uint64_t length = std::get<1>(header);
+		const buf_t* payload = frame + hdr_size;
+		const size_t frame_size = hdr_size + (size_t)length;
+
+		if (!compressed)
+			return decode_payload(args, payload, (size_t)length) ? frame_size : 0;
+
+		constexpr size_t raw_size_bytes = sizeof(uint32_t);
+		if (length < raw_size_bytes)
+			return 0;
+		// the raw size comes from the wire : bounded by the block length and max_decompressed_size
+		const uint32_t raw_size = SerDes<buf_t, big_endian>::template extract<uint32_t>(payload);
+		if (raw_size > max_raw_size || raw_size > serdes::lz::decompress_bound((size_t)length - raw_size_bytes))
+			return 0;
+		scratch.resize(raw_size);
+		if (!serdes::lz::decompress((const uint8_t*)payload + raw_size_bytes, (size_t)length - raw_size_bytes,
+			(uint8_t*)scratch.data(), raw_size))
+			return 0;
+		return decode_payload(args, scratch.data(), raw_size) ? frame_size : 0;
+	}
+
+	// The arguments fill exactly 'size' bytes (an empty payload for a command without arguments)
+	template<typename Tup>
+	static inline bool decode_payload(Tup& args, const buf_t* payload, size_t size) {
+		if (size == 0)
+			return std::tuple_size<Tup>::value == 0;
+		return SerDes<buf_t, big_endian>::deserialize_checked(args, payload, size) == size;
+	}
+
+};
+
+//--------------------------------------------------------------------------------------------------
+// Command fragmentation
+//--------------------------------------------------------------------------------------------------
+
+// Splits a command frame into fragment frames of at most max_fragment_size bytes.
+// Fragment payloads point into the source frame and only the fragment headers are written,
+// so a transport can send each fragment with a gather write (header, payload) without copying.
+template<typename buf_t = uint8_t, bool big_endian = false>
+class CommandFragmenter {
+public:
+	struct fragment {
+		const buf_t* header; // fragment_header_size bytes
+		const buf_t* payload;
+		size_t payload_size;
+	};
+
+	explicit CommandFragmenter(size_t max_fragment_size)
+		: max_payload(max_fragment_size - fragment_header_size) {
+		assert(max_fragment_size > fragment_header_size && "fragment size is too small");
+		assert(max_fragment_size - sizeof(header_type) < length_header_t::extended_length && "fragment size is too large");
+	}
+
+	// The returned fragments are valid until the next split() call and while 'frame' is alive.
+	inline const std::vector<fragment>& split(const buf_t* frame, uint64_t frame_size) {
+		const uint32_t message_id = next_message_id++;
+		const size_t count = (size_t)((frame_size + max_payload - 1) / max_payload);
+		headers.resize(count * fragment_header_size);
+		fragments.clear();
+		for (size_t i = 0; i < count; i++) {
+			const uint64_t offset = (uint64_t)i * max_payload;
+			const size_t slice = (size_t)std::min<uint64_t>(max_payload, frame_size - offset);
+			buf_t* header = headers.data() + i * fragment_header_size;
+			SerDes<buf_t, big_endian>::serialize(header, fragment_header_type(
+				length_header_t((uint32_t)(fragment_header_size - sizeof(header_type) + slice)),
+				fragment_class_id, (uint16_t)0, message_id, frame_size, offset));
+			fragments.push_back(fragment{ header, frame + offset, slice });
+		}
+		return fragments;
+	}
+
+private:
+	const size_t max_payload;
+	uint32_t next_message_id = 0;
+	std::vector<buf_t> headers;
+	std::vector<fragment> fragments;
+};
+
+// Rebuilds command frames from fragment frames, in any order and interleaved between messages.
+// Each fragment is copied once, directly to its final offset. A frame carried by a single
+// fragment is returned in place without a copy. A fragment overlapping the received ranges
+// of its message (a duplicate) is dropped, and frames over 'max_frame_size' are rejected.
+// The incomplete messages hold at most 'max_pending_bytes' : a new message that would exceed it
+// evicts the oldest ones, and drop() discards a message the transport gave up on.
+template<typename buf_t = uint8_t, bool big_endian = false>
+class CommandReassembler {
+public:
+	static constexpr uint64_t default_max_frame_size = (uint64_t)1 << 30;
+	static constexpr uint64_t default_max_pending_bytes = (uint64_t)1 << 30;
+
+	explicit CommandReassembler(uint64_t max_frame_size = default_max_frame_size,
+		uint64_t max_pending_bytes = default_max_pending_bytes)
+		: max_size(std::min(max_frame_size, max_pending_bytes)), max_pending(max_pending_bytes) {}
+
+	// Returns the complete command frame when 'fragment_frame' completes a message, otherwise nullptr.
+	// A fragment whose header or slice does not fit in 'available' bytes is rejected.
+	// The returned frame is valid until the next push() call.
+	inline const buf_t* push(const buf_t* fragment_frame, size_t available, uint64_t& frame_size) {
+		if (available < fragment_header_size)
+			return nullptr;
+		fragment_header_type header;
+		SerDes<buf_t, big_endian>::deserialize(header, fragment_frame);
+		length_header_t& len_header = std::get<0>(header);
+		if (!len_header.check() || std::get<1>(header) != fragment_class_id ||
+			len_header.length < fragment_header_size - sizeof(header_type))
+			return nullptr;
+
+		const size_t slice = len_header.length - (fragment_header_size - sizeof(header_type));
+		if (slice > available - fragment_header_size)
+			return nullptr;
+		const uint32_t message_id = std::get<3>(header);
+		const uint64_t total = std::get<4>(header);
+		const uint64_t offset = std::get<5>(header);
+		if (total > max_size || offset > total || slice > total - offset)
+			return nullptr;
+
+		const buf_t* payload = fragment_frame + fragment_header_size;
+		if (offset == 0 && slice == total) {
+			frame_size = total;
+			return payload;
+		}
+		if (slice == 0)
+			return nullptr;
+
+		auto it = pending.find(message_id);
+		if (it != pending.end() && it->second.total != total)
+			it = erase(it);
+		if (it == pending.end()) {
+			while (!pending.empty() && total > max_pending - pending_size)
+				erase(pending.find(arrivals.begin()->second));
+			it = pending.emplace(message_id, partial_frame()).first;
+			it->second.data.resize((size_t)total);
+			it->second.total = total;
+			it->second.arrival = next_arrival++;
+			arrivals.emplace(it->second.arrival, message_id);
+			pending_size += total;
+		}
+		partial_frame& partial = it->second;
+		if (!add_range(partial.received, offset, offset + slice))
+			return nullptr;
+		memcpy(partial.data.data() + offset, payload, slice);
+		if (partial.received.size() != 1 || partial.received.begin()->first != 0 ||
+			partial.received.begin()->second != total)
+			return nullptr;
+
+		completed.swap(partial.data);
+		erase(it);
+		frame_size = total;
+		return completed.data();
+	}
+
+	// Discards the fragments received for 'message_id', false when none are pending.
+	inline bool drop(uint32_t message_id) {
+		auto it = pending.find(message_id);
+		if (it == pending.end())
+			return false;
+		erase(it);
+		return true;
+	}
+
+	inline size_t pending_messages() const {
+		return pending.size();
+	}
+
+	// Bytes buffered for the incomplete messages
+	inline uint64_t pending_bytes() const {
+		return pending_size;
+	}
+
+private:
+	struct partial_frame {
+		std::vector<buf_t> data;
+		std::map<uint64_t, uint64_t> received; // [offset, end) ranges, adjacent ones merged
+		uint64_t total = 0; // frame size, counted in pending_size (data is swapped out on completion)
+		uint64_t arrival = 0; // key in 'arrivals'
+	};
+
+	typedef typename std::unordered_map<uint32_t, partial_frame>::iterator pending_iterator;
+
+	inline pending_iterator erase(pending_iterator it) {
+		pending_size -= it->second.total;
+		arrivals.erase(it->second.arrival);
+		return pending.erase(it);
+	}
+
+	// Adds [offset, end) to the received ranges, false when it overlaps one of them.
+	static inline bool add_range(std::map<uint64_t, uint64_t>& ranges, uint64_t offset, uint64_t end) {
+		auto next = ranges.lower_bound(offset);
+		if (next != ranges.end() && next->first < end)
+			return false;
+		if (next != ranges.begin()) {
+			auto prev = std::prev(next);
+			if (prev->second > offset)
+				return false;
+			if (prev->second == offset) {
+				offset = prev->first;
+				ranges.erase(prev);
+			}
+		}
+		if (next != ranges.end() && next->first == end) {
+			end = next->second;
+			ranges.erase(next);
+		}
+		ranges[offset] = end;
+		return true;
+	}
+
+	const uint64_t max_size;
+	const uint64_t max_pending;
+	std::unordered_map<uint32_t, partial_frame> pending;
+	std::map<uint64_t, uint32_t> arrivals; // message ids of 'pending', oldest first
+	uint64_t next_arrival = 0;
+	uint64_t pending_size = 0;
+	std::vector<buf_t> completed;
 };
 
 
@@ -0,0 +1,61 @@
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+//----------------------------------------------------------------------------------------------------
+// Compile time of a translation unit using the message codecs, header-only against extern
+// templates (plus the one-off codec library).
+//   COMPILE_BENCH [runs]  (or the compile_benchmark target)
+//----------------------------------------------------------------------------------------------------
+
+namespace {
+
+	// Seconds to compile 'source' with 'defines', negative on a compile error
+	double compile_seconds(const std::string& source, const std::string& defines) {
+		const std::string command = std::string(SERDES_BENCH_CXX) + " " + SERDES_BENCH_FLAGS + " " + defines +
+			" -I" + SERDES_BENCH_SOURCE_DIR + "/include -I" + SERDES_BENCH_SOURCE_DIR + "/src -c " +
+			SERDES_BENCH_SOURCE_DIR + "/" + source + " -o " + SERDES_BENCH_OUTPUT;
+		const auto start = std::chrono::steady_clock::now();
+		const int status = std::system(command.c_str());
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (status != 0) {
+			printf("compile fail : %s\n", command.c_str());
+			return -1.0;
+		}
+		return seconds;
+	}
+
+	// Best of 'runs', to leave out the scheduling noise
+	double best_seconds(const std::string& source, const std::string& defines, int runs) {
+		double best = -1.0;
+		for (int i = 0; i < runs; i++) {
+			const double seconds = compile_seconds(source, defines);
+			if (seconds < 0.0)
+				return -1.0;
+			if (best < 0.0 || seconds < best)
+				best = seconds;
+		}
+		return best;
+	}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const int runs = argc > 1 ? std::max(atoi(argv[1]), 1) : 3;
+
+	const double header_only = best_seconds("src/compile_bench/user_tu.cpp", "-DSERDES_CODEC_HEADER_ONLY", runs);
+	const double extern_tu = best_seconds("src/compile_bench/user_tu.cpp", "", runs);
+	const double library = best_seconds("src/messages/messages.cpp", "", runs);
+	if (header_only < 0.0 || extern_tu < 0.0 || library < 0.0)
+		return EXIT_FAILURE;
+
+	printf("header-only      : %.3f s per translation unit\n", header_only);
+	printf("extern templates : %.3f s per translation unit, %.3f s once for the codec library\n", extern_tu, library);
+	if (header_only > extern_tu)
+		printf("saved            : %.3f s per translation unit, the library pays off from %.1f translation units\n",
+			header_only - extern_tu, library / (header_only - extern_tu));
+	return EXIT_SUCCESS;
+}
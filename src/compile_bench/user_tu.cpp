@@ -0,0 +1,22 @@
+
+#include "messages/messages.hpp"
+
+// A translation unit using every message codec, compiled by COMPILE_BENCH
+// with and without SERDES_CODEC_HEADER_ONLY.
+
+#define ROUND_TRIP(type) \
+	{ \
+		type value{}; \
+		std::vector<uint8_t> buf; \
+		MessageCodec<type>::append(buf, value); \
+		type decoded{}; \
+		size += MessageCodec<type>::deserialize_checked(decoded, buf.data(), buf.size()); \
+	}
+
+size_t round_trip_all();
+
+size_t round_trip_all() {
+	size_t size = 0;
+	MESSAGE_TYPES(ROUND_TRIP)
+	return size;
+}
@@ -0,0 +1,6 @@
+
+#include "serdes_codec_impl.hpp"
+#include "messages.hpp"
+
+// The only translation unit instantiating the message codecs
+MESSAGE_TYPES(SERDES_INSTANTIATE_CODEC)
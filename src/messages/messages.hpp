@@ -0,0 +1,55 @@
+#pragma once
+#ifndef __MESSAGES_HPP__
+#define __MESSAGES_HPP__
+
+#include "serdes_codec.hpp"
+#include <array>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+//----------------------------------------------------------------------------------------------------
+// Message set of the codec library (SERDES_MESSAGES), declared once for every translation unit
+//----------------------------------------------------------------------------------------------------
+
+namespace messages {
+
+	struct position {
+		double x;
+		double y;
+		double z;
+	};
+
+	typedef std::tuple<uint32_t, std::string, std::string> login_request;
+	typedef std::tuple<uint32_t, bool, std::string, std::vector<std::string>> login_reply;
+	typedef std::tuple<uint64_t, std::string, double, double, uint32_t> quote;
+	typedef std::tuple<uint64_t, std::vector<std::tuple<double, uint32_t>>, std::vector<std::tuple<double, uint32_t>>> order_book;
+	typedef std::tuple<uint64_t, std::string, int32_t, double, std::map<std::string, std::string>> order;
+	typedef std::tuple<uint64_t, uint32_t, std::string> order_reply;
+	typedef std::tuple<uint32_t, position, std::array<float, 4>> pose;
+	typedef std::tuple<uint32_t, std::vector<position>, std::vector<uint16_t>> trajectory;
+	typedef std::tuple<std::string, std::map<std::string, std::vector<double>>> metrics;
+	typedef std::tuple<uint32_t, std::vector<std::tuple<std::string, uint32_t, std::vector<uint8_t>>>> file_chunks;
+	typedef std::tuple<uint16_t, std::string, std::vector<std::tuple<std::string, int64_t>>> log_record;
+	typedef std::tuple<std::vector<std::vector<float>>, std::vector<std::string>> table;
+
+} // namespace messages
+
+#define MESSAGE_TYPES(X) \
+	X(messages::login_request) \
+	X(messages::login_reply) \
+	X(messages::quote) \
+	X(messages::order_book) \
+	X(messages::order) \
+	X(messages::order_reply) \
+	X(messages::pose) \
+	X(messages::trajectory) \
+	X(messages::metrics) \
+	X(messages::file_chunks) \
+	X(messages::log_record) \
+	X(messages::table)
+
+MESSAGE_TYPES(SERDES_EXTERN_CODEC)
+
+#endif // !__MESSAGES_HPP__
@@ -0,0 +1,273 @@
+
+#include "serializer_deserializer.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_map>
+
+//----------------------------------------------------------------------------------------------------
+// Round-trip stress : random values of nested types are encoded (also by serialize_bounded) and
+// decoded on every thread, in both byte orders, then truncated and mutated copies are fed to
+// deserialize_checked().
+//   SERDES_STRESS [iterations per thread] [threads] [seed]
+//----------------------------------------------------------------------------------------------------
+
+namespace {
+
+	// Random sizes : mostly small, sometimes empty, rarely huge.
+	// 'budget' bounds the elements of one value, so nested huge containers stay affordable.
+	struct generator {
+		std::mt19937_64 rng;
+		size_t budget;
+
+		explicit generator(uint64_t seed) : rng(seed), budget(0) {}
+
+		inline uint64_t next() { return rng(); }
+
+		inline size_t count() {
+			const uint64_t roll = next() % 256;
+			size_t nums = roll < 32 ? 0 : roll == 255 ? (size_t)(1 << 16) + (size_t)(next() % 4096) : (size_t)(next() % 9);
+			nums = std::min(nums, budget);
+			budget -= nums;
+			return nums;
+		}
+	};
+
+	template<typename Tp>
+	std::enable_if_t<std::is_integral<Tp>::value> fill(generator& gen, Tp& value);
+	template<typename Tp>
+	std::enable_if_t<std::is_floating_point<Tp>::value> fill(generator& gen, Tp& value);
+	void fill(generator& gen, std::string& value);
+	void fill(generator& gen, std::vector<bool>& value);
+	template<typename Tp>
+	std::enable_if_t<serdes::is_container_v<Tp> && !std::is_same<std::string, Tp>::value> fill(generator& gen, Tp& value);
+	template<typename Tp>
+	std::enable_if_t<serdes::is_associative_v<Tp>> fill(generator& gen, Tp& value);
+	template<typename Tp, size_t N>
+	void fill(generator& gen, std::array<Tp, N>& value);
+	template<typename... Args>
+	void fill(generator& gen, std::tuple<Args...>& value);
+#if __cplusplus >= 201703L
+	template<typename Tp>
+	void fill(generator& gen, std::optional<Tp>& value);
+	template<typename... Args>
+	void fill(generator& gen, std::variant<Args...>& value);
+#endif
+
+	template<typename Tp>
+	std::enable_if_t<std::is_integral<Tp>::value> fill(generator& gen, Tp& value) {
+		value = std::is_same<bool, Tp>::value ? (Tp)(gen.next() & 1) : (Tp)gen.next();
+	}
+
+	// finite values only, NaN would not compare equal after the round trip
+	template<typename Tp>
+	std::enable_if_t<std::is_floating_point<Tp>::value> fill(generator& gen, Tp& value) {
+		value = (Tp)((double)(int64_t)gen.next() / (double)(1 + gen.next() % 1000003));
+	}
+
+	void fill(generator& gen, std::string& value) {
+		value.resize(gen.count());
+		for (auto& c : value)
+			c = (char)gen.next();
+	}
+
+	void fill(generator& gen, std::vector<bool>& value) {
+		value.resize(gen.count());
+		for (size_t i = 0; i < value.size(); i++)
+			value[i] = (gen.next() & 1) != 0;
+	}
+
+	template<typename Tp>
+	std::enable_if_t<serdes::is_container_v<Tp> && !std::is_same<std::string, Tp>::value> fill(generator& gen, Tp& value) {
+		value.resize(gen.count());
+		for (auto& elem : value)
+			fill(gen, elem);
+	}
+
+	template<typename Tp>
+	std::enable_if_t<serdes::has_mapped_type<Tp>::value> fill_entry(generator& gen, Tp& value, typename Tp::key_type&& key) {
+		typename Tp::mapped_type mapped{};
+		fill(gen, mapped);
+		value.emplace(std::move(key), std::move(mapped));
+	}
+
+	template<typename Tp>
+	std::enable_if_t<!serdes::has_mapped_type<Tp>::value> fill_entry(generator&, Tp& value, typename Tp::key_type&& key) {
+		value.emplace(std::move(key));
+	}
+
+	template<typename Tp>
+	std::enable_if_t<serdes::is_associative_v<Tp>> fill(generator& gen, Tp& value) {
+		const size_t nums = gen.count();
+		for (size_t i = 0; i < nums; i++) {
+			typename Tp::key_type key{};
+			fill(gen, key);
+			fill_entry(gen, value, std::move(key));
+		}
+	}
+
+	template<typename Tp, size_t N>
+	void fill(generator& gen, std::array<Tp, N>& value) {
+		for (auto& elem : value)
+			fill(gen, elem);
+	}
+
+	template<class Tup, size_t... idx>
+	void fill_tuple(generator& gen, Tup& value, std::index_sequence<idx...>) {
+		int order[] = { 0, (fill(gen, std::get<idx>(value)), 0)... };
+		(void)order;
+	}
+
+	template<typename... Args>
+	void fill(generator& gen, std::tuple<Args...>& value) {
+		fill_tuple(gen, value, std::index_sequence_for<Args...>());
+	}
+
+#if __cplusplus >= 201703L
+	template<typename Tp>
+	void fill(generator& gen, std::optional<Tp>& value) {
+		value.reset();
+		if (gen.next() & 1)
+			fill(gen, value.emplace());
+	}
+
+	template<class Var, size_t idx>
+	void fill_variant(generator& gen, Var& value, size_t index) {
+		if constexpr (idx < std::variant_size_v<Var>) {
+			if (index != idx)
+				return fill_variant<Var, idx + 1>(gen, value, index);
+			fill(gen, value.template emplace<idx>());
+		}
+	}
+
+	template<typename... Args>
+	void fill(generator& gen, std::variant<Args...>& value) {
+		fill_variant<std::variant<Args...>, 0>(gen, value, (size_t)(gen.next() % sizeof...(Args)));
+	}
+#endif
+
+	typedef std::vector<std::tuple<uint32_t, std::string, std::vector<double>>> records_type;
+	typedef std::map<std::string, std::vector<std::array<int16_t, 3>>> index_type;
+	typedef std::tuple<std::deque<std::list<std::string>>, std::set<int64_t>,
+		std::unordered_map<uint16_t, std::string>, bool, float, std::vector<bool>> mixed_type;
+	typedef std::vector<std::vector<std::vector<std::tuple<bool, std::string, std::vector<uint8_t>>>>> deep_type;
+#if __cplusplus >= 201703L
+	typedef std::vector<std::variant<uint8_t, std::string, std::optional<std::vector<uint32_t>>>> variant_type;
+#endif
+
+	struct totals {
+		std::atomic<uint64_t> messages{ 0 };
+		std::atomic<uint64_t> bytes{ 0 };
+		std::atomic<uint64_t> mutations{ 0 };
+		std::atomic<uint64_t> accepted{ 0 }; // mutated buffers that still decode
+		std::atomic<uint64_t> failures{ 0 };
+	};
+
+	// Round trip of one random value, then its truncated and mutated copies.
+	template<class serdes_type, typename Tp>
+	void stress_value(generator& gen, totals& sum, std::vector<uint8_t>& buf) {
+		Tp src{};
+		gen.budget = 1 << 18;
+		fill(gen, src);
+
+		const size_t size = serdes_type::payload_size(src);
+		buf.resize(size);
+		bool pass = serdes_type::serialize(buf.data(), src) == size;
+		pass &= serdes_type::template validate<Tp>(buf.data(), size) == size;
+		Tp dst{};
+		pass &= serdes_type::deserialize_checked(dst, buf.data(), size) == size && dst == src;
+
+		// the bounded encoder writes the same bytes, and fails one byte short
+		std::vector<uint8_t> bounded(size);
+		pass &= serdes_type::serialize_bounded(bounded.data(), size, src) == size && bounded == buf;
+		if (size > 0)
+			pass &= serdes_type::serialize_bounded(bounded.data(), size - 1, src) == 0;
+
+		// a strict prefix never validates
+		if (size > 0)
+			pass &= serdes_type::template validate<Tp>(buf.data(), (size_t)(gen.next() % size)) == 0;
+
+		// random bytes changed : rejected or decoded, never out of bounds
+		for (int round = 0; round < 4 && size > 0; round++) {
+			std::vector<uint8_t> mutated(buf);
+			const size_t flips = 1 + gen.next() % 4;
+			for (size_t i = 0; i < flips; i++)
+				mutated[gen.next() % size] ^= (uint8_t)(1 + gen.next() % 255);
+			const size_t length = gen.next() % 8 == 0 ? (size_t)(gen.next() % size) : size;
+			Tp decoded{};
+			if (serdes_type::deserialize_checked(decoded, mutated.data(), length) != 0)
+				sum.accepted.fetch_add(1, std::memory_order_relaxed);
+			sum.mutations.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		sum.messages.fetch_add(1, std::memory_order_relaxed);
+		sum.bytes.fetch_add(size, std::memory_order_relaxed);
+		if (!pass) {
+			sum.failures.fetch_add(1, std::memory_order_relaxed);
+			printf("round trip fail : %s, %zu bytes, %s endian\n", serdes_type::template type_name<Tp>().c_str(),
+				size, std::is_same<serdes_type, SerDesBig>::value ? "big" : "little");
+		}
+	}
+
+	template<class serdes_type>
+	void stress_types(generator& gen, totals& sum, std::vector<uint8_t>& buf) {
+		switch (gen.next() % 5) {
+		case 0: stress_value<serdes_type, records_type>(gen, sum, buf); break;
+		case 1: stress_value<serdes_type, index_type>(gen, sum, buf); break;
+		case 2: stress_value<serdes_type, mixed_type>(gen, sum, buf); break;
+		case 3: stress_value<serdes_type, deep_type>(gen, sum, buf); break;
+#if __cplusplus >= 201703L
+		case 4: stress_value<serdes_type, variant_type>(gen, sum, buf); break;
+#endif
+		default: stress_value<serdes_type, records_type>(gen, sum, buf); break;
+		}
+	}
+
+	void stress_thread(uint64_t seed, size_t iterations, totals& sum) {
+		generator gen(seed);
+		std::vector<uint8_t> buf;
+		for (size_t i = 0; i < iterations; i++) {
+			if (gen.next() & 1)
+				stress_types<SerDesBig>(gen, sum, buf);
+			else
+				stress_types<SerDesLittle>(gen, sum, buf);
+		}
+	}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+	const size_t iterations = argc > 1 ? (size_t)strtoull(argv[1], nullptr, 10) : 2000;
+	const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	const size_t thread_nums = argc > 2 ? std::max<size_t>((size_t)strtoull(argv[2], nullptr, 10), 1) : hardware;
+	const uint64_t seed = argc > 3 ? (uint64_t)strtoull(argv[3], nullptr, 10) :
+		(uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+
+	printf("stress : %zu iterations x %zu threads, seed %llu\n", iterations, thread_nums, (unsigned long long)seed);
+
+	totals sum;
+	const auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < thread_nums; i++)
+		threads.emplace_back(stress_thread, seed + i, iterations, std::ref(sum));
+	for (auto& th : threads)
+		th.join();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	const uint64_t messages = sum.messages.load();
+	const uint64_t bytes = sum.bytes.load();
+	printf("round trips : %llu messages, %.1f MB, %.3f s\n", (unsigned long long)messages, (double)bytes / 1e6, seconds);
+	printf("throughput  : %.0f messages/s, %.1f MB/s\n", (double)messages / seconds, (double)bytes / 1e6 / seconds);
+	printf("mutations   : %llu, %llu decoded, the others rejected\n",
+		(unsigned long long)sum.mutations.load(), (unsigned long long)sum.accepted.load());
+
+	const bool pass = sum.failures.load() == 0;
+	printf("stress : %s\n", pass ? "pass" : "fail");
+	return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
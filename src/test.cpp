@@ -1,9 +1,29 @@
 
 #include "serializer_deserializer.hpp"
+#ifdef __unix__
+#include "serdes_mmap.hpp"
+#include "serdes_record_log.hpp"
+#include "serdes_shm.hpp"
+#include "serdes_async.hpp"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <signal.h>
+#endif
 #include <iostream>
 #include <cstring>
 #include <typeinfo>
 #include <list>
+#include <deque>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <thread>
+#include "serdes_queue.hpp"
+#include "serdes_stats.hpp"
+#include "serdes_json.hpp"
+#include "serdes_batch.hpp"
+#include "messages/messages.hpp"
 
 
 //----------------------------------------------------------------------------------------------------
@@ -180,6 +200,32 @@ typedef std::tuple<COMPLEX_O6, arithmeticStruct, defaultConstructorDeleteClass>
 static_assert(!SerDesLittle::is_serdesable_v<COMPLEX_X1>, "");
 static_assert(!SerDesLittle::is_serdesable_v<COMPLEX_X2>, "");
 
+//----------------------------------------------------------------------------------------------------
+#if defined(__unix__) && defined(SERDES_ASYNC_COROUTINE)
+// Coroutine started eagerly, its frame is freed when it returns
+struct detached_task {
+	struct promise_type {
+		detached_task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+// GCC lowers the coroutine body to a switch without a default case
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wswitch-default"
+#endif
+static detached_task await_send(AsyncCommandWriter<>& writer, int& result) {
+	result = co_await writer.async_send<3, 7>(std::string("pending")) ? 1 : 0;
+}
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+#endif
+
 //----------------------------------------------------------------------------------------------------
 
 int main() 
@@ -387,6 +433,1035 @@ int main()
 			printf("buf[%u] : %d compare pass\n\n", (uint32_t)buf_size, compare);
 
 	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Compressed command frame
+		typedef std::tuple<std::string, std::vector<double>> snapshot_type;
+
+		snapshot_type serial_src, deserial_dst;
+		std::get<0>(serial_src) = "sensor snapshot";
+		for (size_t i = 0; i < 20000; i++)
+			std::get<1>(serial_src).push_back((double)(i % 64));
+
+		DynamicSerDes<> dyn_serdes;
+		std::vector<uint8_t> plain, compressed;
+		dyn_serdes.build_command<1, 2>(plain, serial_src);
+		dyn_serdes.set_compress_threshold(1024);
+		size_t frame_size = dyn_serdes.build_command<1, 2>(compressed, serial_src);
+
+		// a plain receiver sees a checksum error
+		header_type header;
+		bool pass = frame_size == compressed.size() && compressed.size() < plain.size() / 3 &&
+			!DynamicSerDes<>::parse_header(compressed.data(), header) && std::get<0>(header).is_compressed() &&
+			DynamicSerDes<>::frame_size(compressed.data(), compressed.size()) == compressed.size();
+		pass = pass && dyn_serdes.parse_command(compressed.data(), deserial_dst) == compressed.size() &&
+			deserial_dst == serial_src;
+
+		// raw size over the limit, or more than the block can expand to
+		std::vector<uint8_t> oversized(compressed);
+		const uint32_t raw_sizes[] = { (uint32_t)DynamicSerDes<>::default_max_decompressed_size + 1,
+			(uint32_t)(compressed.size() * 256) };
+		for (uint32_t raw_size : raw_sizes) {
+			memcpy(oversized.data() + sizeof(header_type), &raw_size, sizeof(raw_size));
+			pass = pass && dyn_serdes.parse_command(oversized.data(), deserial_dst) == 0;
+		}
+		dyn_serdes.set_max_decompressed_size(1024);
+		pass = pass && dyn_serdes.parse_command(compressed.data(), deserial_dst) == 0;
+		dyn_serdes.set_max_decompressed_size(DynamicSerDes<>::default_max_decompressed_size);
+
+		// a forged element count inside the (de)compressed payload is rejected, not read past the buffer
+		std::vector<uint8_t> forged;
+		dyn_serdes.build_command<1, 2>(forged, (uint32_t)100000000, std::vector<uint8_t>(4000));
+		std::tuple<std::vector<uint8_t>> forged_dst;
+		pass = pass && DynamicSerDes<>::frame_size(forged.data(), forged.size()) == forged.size() &&
+			dyn_serdes.parse_command(forged.data(), forged.size(), forged_dst) == 0;
+		dyn_serdes.set_compress_threshold(DynamicSerDes<>::no_compress);
+		dyn_serdes.build_command<1, 2>(forged, (uint32_t)100000000, std::vector<uint8_t>(4000));
+		pass = pass && dyn_serdes.parse_command(forged.data(), forged.size(), forged_dst) == 0;
+		// a frame longer than the available bytes is rejected before its payload is read
+		pass = pass && dyn_serdes.parse_command(compressed.data(), compressed.size() - 1, deserial_dst) == 0 &&
+			dyn_serdes.parse_command(compressed.data(), 3, deserial_dst) == 0 &&
+			dyn_serdes.parse_command(compressed.data(), compressed.size(), deserial_dst) == compressed.size();
+
+		printf("compress[%u -> %u] : %s\n\n", (uint32_t)plain.size(), (uint32_t)frame_size, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Extended header for payloads over 16MB, fragmented and reassembled out of order
+		typedef std::tuple<uint32_t, std::vector<uint8_t>> bulk_type;
+
+		bulk_type serial_src, deserial_dst;
+		std::get<0>(serial_src) = 0xC0FFEE;
+		std::get<1>(serial_src).resize(length_header_t::max_packet_size + 1024);
+		for (size_t i = 0; i < std::get<1>(serial_src).size(); i++)
+			std::get<1>(serial_src)[i] = (uint8_t)(i * 7);
+
+		DynamicSerDes<> dyn_serdes;
+		std::vector<uint8_t> frame;
+		size_t frame_size = dyn_serdes.build_command<3, 4>(frame, serial_src);
+
+		extended_header_type header;
+		bool pass = frame_size == frame.size() &&
+			DynamicSerDes<>::parse_header(frame.data(), header) == sizeof(length_header_t) + sizeof(uint64_t) + sizeof(uint16_t) * 2 &&
+			std::get<0>(header).is_extended() && std::get<1>(header) == SerDesLittle::payload_size(serial_src);
+
+		CommandFragmenter<> fragmenter(64 * 1024);
+		CommandReassembler<> reassembler;
+		auto fragments = fragmenter.split(frame.data(), frame.size());
+		std::swap(fragments.front(), fragments.back());
+
+		const uint8_t* rebuilt = nullptr;
+		uint64_t rebuilt_size = 0;
+		size_t completions = 0;
+		std::vector<uint8_t> fragment_frame;
+		CommandReassembler<> bounded_reassembler(1024 * 1024);
+		for (size_t i = 0; i < fragments.size(); i++) {
+			// transport side
+			fragment_frame.assign(fragments[i].header, fragments[i].header + fragment_header_size);
+			fragment_frame.insert(fragment_frame.end(), fragments[i].payload, fragments[i].payload + fragments[i].payload_size);
+			// duplicated fragments are dropped, a frame over the limit is never buffered
+			for (int repeat = 0; repeat < (i % 2 ? 2 : 1); repeat++) {
+				if (auto complete = reassembler.push(fragment_frame.data(), fragment_frame.size(), rebuilt_size)) {
+					rebuilt = complete;
+					completions++;
+				}
+			}
+			pass = pass && bounded_reassembler.push(fragment_frame.data(), fragment_frame.size(), rebuilt_size) == nullptr;
+		}
+		pass = pass && rebuilt && completions == 1 && rebuilt_size == frame.size() && reassembler.pending_messages() == 0 &&
+			bounded_reassembler.pending_messages() == 0 &&
+			dyn_serdes.parse_command(rebuilt, deserial_dst) == frame.size() && deserial_dst == serial_src;
+
+		// single fragment message is returned in place
+		std::vector<uint8_t> small_frame;
+		dyn_serdes.build_command<3, 5>(small_frame, (uint32_t)1);
+		auto& single = fragmenter.split(small_frame.data(), small_frame.size());
+		fragment_frame.assign(single[0].header, single[0].header + fragment_header_size);
+		fragment_frame.insert(fragment_frame.end(), single[0].payload, single[0].payload + single[0].payload_size);
+		pass = pass && reassembler.push(fragment_frame.data(), fragment_frame.size(), rebuilt_size) == fragment_frame.data() + fragment_header_size;
+
+		// a fragment longer than the received bytes is rejected
+		pass = pass && reassembler.push(fragment_frame.data(), fragment_frame.size() - 1, rebuilt_size) == nullptr &&
+			reassembler.push(fragment_frame.data(), fragment_header_size - 1, rebuilt_size) == nullptr &&
+			reassembler.pending_messages() == 0;
+
+		// incomplete messages are bounded : the oldest is evicted, drop() discards one
+		CommandReassembler<> capped_reassembler(CommandReassembler<>::default_max_frame_size, 250000);
+		std::vector<std::vector<uint8_t>> message_fragments[4];
+		uint32_t message_ids[4];
+		for (size_t m = 0; m < 4; m++) {
+			std::vector<uint8_t> message;
+			dyn_serdes.build_command<3, 6>(message, (uint32_t)m, std::vector<uint8_t>(100000, (uint8_t)m));
+			for (auto& frag : fragmenter.split(message.data(), message.size())) {
+				message_fragments[m].emplace_back(frag.header, frag.header + fragment_header_size);
+				message_fragments[m].back().insert(message_fragments[m].back().end(), frag.payload, frag.payload + frag.payload_size);
+			}
+			fragment_header_type fragment_header;
+			SerDesLittle::deserialize(fragment_header, message_fragments[m][0].data());
+			message_ids[m] = std::get<3>(fragment_header);
+		}
+		std::tuple<uint32_t, std::vector<uint8_t>> capped_dst;
+		pass = pass && capped_reassembler.push(message_fragments[0][0].data(), message_fragments[0][0].size(), rebuilt_size) == nullptr &&
+			capped_reassembler.push(message_fragments[1][0].data(), message_fragments[1][0].size(), rebuilt_size) == nullptr &&
+			capped_reassembler.push(message_fragments[2][0].data(), message_fragments[2][0].size(), rebuilt_size) == nullptr &&
+			capped_reassembler.pending_messages() == 2 && capped_reassembler.pending_bytes() <= 250000 &&
+			!capped_reassembler.drop(message_ids[0]);
+		for (size_t m = 1; m < 3; m++) {
+			const uint8_t* complete = capped_reassembler.push(message_fragments[m][1].data(), message_fragments[m][1].size(), rebuilt_size);
+			pass = pass && complete && dyn_serdes.parse_command(complete, (size_t)rebuilt_size, capped_dst) == rebuilt_size &&
+				std::get<0>(capped_dst) == m;
+		}
+		pass = pass && capped_reassembler.push(message_fragments[3][0].data(), message_fragments[3][0].size(), rebuilt_size) == nullptr &&
+			capped_reassembler.drop(message_ids[3]) && !capped_reassembler.drop(message_ids[3]) &&
+			capped_reassembler.pending_messages() == 0 && capped_reassembler.pending_bytes() == 0;
+
+		// element counts over uint32_t are escaped
+		uint8_t count_buf[sizeof(uint32_t) + sizeof(uint64_t)];
+		size_t large_count = 0;
+		size_t count_bytes = SerDesLittle::inject_count(count_buf, (size_t)UINT32_MAX);
+		pass = pass && count_bytes == SerDesLittle::count_size((size_t)UINT32_MAX) &&
+			SerDesLittle::extract_count(count_buf, large_count) == count_bytes && large_count == (size_t)UINT32_MAX;
+
+		printf("extended frame[%u], fragments[%u] : %s\n\n", (uint32_t)frame.size(), (uint32_t)fragments.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Lock-free message queues, producers serialize into the ring and the consumer decodes in place
+		typedef std::tuple<uint32_t, uint32_t, std::string> message_type;
+		constexpr uint32_t producers = 4;
+		constexpr uint32_t messages = 20000;
+
+		SpscMessageQueue<> spsc(4096);
+		std::thread spsc_producer([&spsc]() {
+			for (uint32_t i = 0; i < messages; i++)
+				while (spsc.try_push(message_type(0, i, std::string(i % 100, 'x'))) == serdes::push_result::full)
+					std::this_thread::yield();
+		});
+
+		bool pass = true;
+		message_type msg;
+		for (uint32_t i = 0; i < messages; i++) {
+			while (!spsc.try_pop(msg))
+				std::this_thread::yield();
+			pass = pass && std::get<1>(msg) == i && std::get<2>(msg).size() == i % 100;
+		}
+		spsc_producer.join();
+
+		MpscMessageQueue<> mpsc(4096);
+		std::vector<std::thread> mpsc_producers;
+		for (uint32_t p = 0; p < producers; p++)
+			mpsc_producers.emplace_back([&mpsc, p]() {
+				for (uint32_t i = 0; i < messages; i++)
+					while (mpsc.try_push_command<1, 1>(p, i, std::string(i % 50, 'y')) == serdes::push_result::full)
+						std::this_thread::yield();
+			});
+
+		std::vector<uint32_t> next(producers, 0);
+		DynamicSerDes<> dyn_serdes;
+		for (uint32_t n = 0; n < producers * messages; n++) {
+			size_t size;
+			const uint8_t* frame;
+			while (!(frame = mpsc.front(size)))
+				std::this_thread::yield();
+			pass = pass && dyn_serdes.parse_command(frame, msg) == size && std::get<1>(msg) == next[std::get<0>(msg)]++;
+			mpsc.pop();
+		}
+		for (auto& th : mpsc_producers)
+			th.join();
+
+		size_t remain;
+		pass = pass && spsc.front(remain) == nullptr && mpsc.front(remain) == nullptr;
+
+		// a message over max_message_size() is refused in every build, however long the producer retries
+		pass = pass && spsc.try_push(std::string(spsc.max_message_size() + 1, 'z')) == serdes::push_result::too_large &&
+			mpsc.try_push_command<1, 1>(0u, 0u, std::string(4096, 'z')) == serdes::push_result::too_large &&
+			spsc.front(remain) == nullptr && mpsc.front(remain) == nullptr;
+
+		printf("message queue[%u] : %s\n\n", producers * messages + messages, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Delta of a state resent every tick
+		typedef std::tuple<uint64_t, std::array<float, 8>, std::vector<float>, std::vector<std::string>, std::string> state_type;
+		state_type prev(1, {}, std::vector<float>(10000, 1.0f), std::vector<std::string>(100, "symbol"), "idle");
+		state_type cur = prev;
+		std::get<0>(cur)++;
+		std::get<1>(cur)[3] = 2.5f;
+		std::get<2>(cur)[7000] = -1.0f;
+		std::get<3>(cur)[42] = "changed";
+		std::get<3>(cur).push_back("appended");
+
+		std::vector<uint8_t> patch;
+		const size_t delta_size = SerDes<>::serialize_delta(patch, prev, cur);
+		state_type receiver = prev;
+		bool pass = SerDes<>::apply_delta(receiver, patch.data()) == delta_size && receiver == cur &&
+			delta_size * 10 < SerDes<>::payload_size(cur);
+
+		// shrinking containers and an unchanged state
+		state_type next = cur;
+		std::get<2>(next).resize(10);
+		std::get<4>(next) = "run";
+		patch.clear();
+		SerDes<>::serialize_delta(patch, cur, next);
+		pass = pass && SerDes<>::apply_delta(receiver, patch.data()) == patch.size() && receiver == next;
+		patch.clear();
+		pass = pass && SerDes<>::serialize_delta(patch, next, next) == 1 && SerDes<>::apply_delta(receiver, patch.data()) == 1 && receiver == next;
+
+		// std::vector<bool> is resent as a whole when it changed
+		typedef std::tuple<uint32_t, std::vector<bool>> flags_type;
+		const flags_type flags_prev(1, std::vector<bool>(20, false));
+		flags_type flags_cur = flags_prev;
+		std::get<1>(flags_cur)[13] = true;
+		flags_type flags_receiver = flags_prev;
+		patch.clear();
+		SerDes<>::serialize_delta(patch, flags_prev, flags_cur);
+		pass = pass && SerDes<>::apply_delta(flags_receiver, patch.data()) == patch.size() && flags_receiver == flags_cur;
+		patch.clear();
+		pass = pass && SerDes<>::serialize_delta(patch, flags_cur, flags_cur) == 1;
+
+		printf("delta[%zu / %zu] : %s\n\n", delta_size, SerDes<>::payload_size(cur), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Interned strings, within a message and across a session
+		typedef std::tuple<std::vector<std::string>, std::vector<std::tuple<std::string, uint32_t>>, std::vector<float>> tick_type;
+		const char* symbols[] = { "AAPL", "MSFT", "GOOGL", "AMZN", "a rather long tag key for repetition" };
+		tick_type tick;
+		for (uint32_t i = 0; i < 1000; i++) {
+			std::get<0>(tick).push_back(symbols[i % 5]);
+			std::get<1>(tick).emplace_back(symbols[(i * 7) % 5], i);
+		}
+		std::get<2>(tick).assign(16, 0.5f);
+
+		std::vector<uint8_t> message;
+		const size_t interned_size = SerDes<>::serialize_interned(message, tick);
+		tick_type received;
+		bool pass = SerDes<>::deserialize_interned(received, message.data()) == interned_size && received == tick;
+
+		StringDictionary sender, receiver;
+		std::vector<uint8_t> first, second;
+		SerDes<>::serialize_interned(first, tick, sender);
+		const size_t session_size = SerDes<>::serialize_interned(second, tick, sender);
+		pass = pass && SerDes<>::deserialize_interned(received, first.data(), receiver) == first.size() && received == tick;
+		pass = pass && SerDes<>::deserialize_interned(received, second.data(), receiver) == session_size && received == tick;
+		pass = pass && session_size < interned_size && interned_size * 3 < SerDes<>::payload_size(tick) &&
+			sender.size() == 5 && receiver.size() == 5;
+
+		// a session message decoded without the session dictionary refers to unknown strings
+		StringDictionary fresh;
+		pass = pass && SerDes<>::deserialize_interned(received, second.data(), fresh) == 0;
+
+		printf("interned[%zu -> %zu, session %zu] : %s\n\n", SerDes<>::payload_size(tick), interned_size, session_size, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Associative and node based containers, optional and variant
+		typedef std::tuple<std::map<std::string, std::vector<int>>, std::unordered_map<uint32_t, float>,
+			std::set<std::string>, std::unordered_set<uint64_t>, std::multimap<int, int>,
+			std::deque<uint16_t>, std::list<std::string>> containers_type;
+		static_assert(SerDes<>::is_serdesable_v<containers_type>, "");
+		static_assert(SerDes<>::is_serdesable_v<std::vector<bool>>, "");
+
+		containers_type serial_src, deserial_dst;
+		std::get<0>(serial_src) = { { "x", { 1, 2 } }, { "y", {} } };
+		for (uint32_t i = 0; i < 100; i++)
+			std::get<1>(serial_src)[i] = (float)i * 0.5f;
+		std::get<2>(serial_src) = { "q", "w" };
+		std::get<3>(serial_src) = { 5, 6, 7 };
+		std::get<4>(serial_src) = { { 1, 2 }, { 1, 3 } };
+		std::get<5>(serial_src) = { 1, 2, 3 };
+		std::get<6>(serial_src) = { "l1", "l2" };
+		std::get<0>(deserial_dst)["stale"] = { 9 };
+
+		std::vector<uint8_t> buf(SerDes<>::payload_size(serial_src));
+		const size_t written = SerDes<>::serialize(buf.data(), serial_src);
+		bool pass = written == buf.size() && SerDes<>::deserialize(deserial_dst, buf.data()) == buf.size() &&
+			SerDes<>::skip<containers_type>(buf.data()) == buf.size() && deserial_dst == serial_src;
+
+#if __cplusplus >= 201703L
+		typedef std::tuple<std::optional<std::string>, std::optional<int>,
+			std::variant<int, std::string, std::vector<float>>, std::vector<std::optional<uint8_t>>> tagged_type;
+		tagged_type tagged_src{ std::string("hi"), std::nullopt, std::vector<float>{ 1, 2 }, { 1, std::nullopt, 3 } };
+		tagged_type tagged_dst{ std::nullopt, 5, 7, {} };
+		std::vector<uint8_t> tagged(SerDes<>::payload_size(tagged_src));
+		SerDes<>::serialize(tagged.data(), tagged_src);
+		pass = pass && SerDes<>::deserialize(tagged_dst, tagged.data()) == tagged.size() && tagged_dst == tagged_src;
+#endif
+
+		printf("associative containers[%zu] : %s\n\n", written, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Recycled decoding into a destination reused across messages
+		typedef std::tuple<std::vector<std::string>, std::vector<std::tuple<std::string, std::vector<int>>>> batch_type;
+		batch_type large, small;
+		for (int i = 0; i < 100; i++) {
+			std::get<0>(large).push_back(std::string(100, (char)('a' + i % 26)));
+			std::get<1>(large).emplace_back(std::string(64, 'k'), std::vector<int>(50, i));
+		}
+		for (int i = 0; i < 10; i++) {
+			std::get<0>(small).push_back(std::string(20, 's'));
+			std::get<1>(small).emplace_back("key", std::vector<int>(2, i));
+		}
+		std::vector<uint8_t> large_buf(SerDes<>::payload_size(large)), small_buf(SerDes<>::payload_size(small));
+		SerDes<>::serialize(large_buf.data(), large);
+		SerDes<>::serialize(small_buf.data(), small);
+
+		DecodeRecycler recycler;
+		batch_type dst;
+		bool pass = SerDes<>::deserialize_recycled(dst, large_buf.data(), recycler) == large_buf.size() && dst == large;
+		pass = pass && SerDes<>::deserialize_recycled(dst, small_buf.data(), recycler) == small_buf.size() && dst == small;
+		// inner buffers kept their capacity, dropped elements are spares
+		for (auto& str : std::get<0>(dst))
+			pass = pass && str.capacity() >= 100;
+		pass = pass && recycler.spares<std::string>().size() == 90 &&
+			recycler.spares<std::tuple<std::string, std::vector<int>>>().size() == 90;
+		pass = pass && SerDes<>::deserialize_recycled(dst, large_buf.data(), recycler) == large_buf.size() && dst == large &&
+			recycler.spares<std::string>().empty();
+
+		printf("recycled decoding[%zu, %zu] : %s\n\n", large_buf.size(), small_buf.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Per-thread statistics merged from exited and live threads
+		typedef std::tuple<uint32_t, std::vector<float>> args_type;
+		constexpr int iterations = 1000;
+		const std::vector<float> values(16, 1.0f);
+		const size_t frame_bytes = DynamicSerDes<>::command_size((uint32_t)0, values);
+		auto worker = [&values]() {
+			DynamicSerDes<uint8_t, false, serdes::thread_stats> dyn_serdes;
+			std::vector<uint8_t> frame;
+			args_type args;
+			for (int i = 0; i < iterations; i++) {
+				dyn_serdes.build_command<7, 3>(frame, (uint32_t)i, values);
+				dyn_serdes.parse_command(frame.data(), args);
+			}
+		};
+		std::thread first(worker), second(worker);
+		first.join();
+		second.join();
+
+		std::vector<uint8_t> buf(SerDes<>::payload_size(std::string("stats")));
+		InstrumentedSerDes<serdes::thread_stats>::serialize(buf.data(), std::string("stats"));
+
+		bool pass = true;
+		int found = 0;
+		const auto entries = serdes::thread_stats::snapshot();
+		for (auto& entry : entries) {
+			if (entry.command == serdes::command_key(7, 3)) {
+				found++;
+				uint64_t histogram = 0;
+				for (uint64_t bucket : entry.latency)
+					histogram += bucket;
+				pass = pass && entry.type == SerDes<>::type_name<args_type>() && entry.count == 2 * iterations &&
+					entry.bytes == 2 * iterations * frame_bytes && histogram == entry.count;
+			}
+			else if (entry.command == serdes::no_command) {
+				found++;
+				pass = pass && !entry.decode && entry.count == 1 && entry.bytes == buf.size();
+			}
+		}
+		pass = pass && found == 3;
+		if (!pass)
+			printf("%s", serdes::thread_stats::report(entries).c_str());
+
+		printf("statistics[%zu] : %s\n\n", entries.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Text and JSON formatting into a reused buffer
+		auto message = std::make_tuple(std::string("say \"hi\"\n"), -42, 0.1, 1e21f, 255U,
+			std::map<std::string, std::vector<double>>{ { "a", { 1.5, -0.25 } }, { "b", {} } },
+			std::map<int, bool>{ { 1, true }, { 2, false } }, std::set<uint8_t>{ 3, 4 },
+			std::numeric_limits<double>::quiet_NaN(), INT64_MIN);
+		const std::string expected_text =
+			"{\"say \"hi\"\n\", -42, 0.1, 1e+21, 255, {\"a\": {1.5, -0.25}, \"b\": {}}, {1: 1, 2: 0}, {3, 4}, nan, -9223372036854775808}";
+		const std::string expected_json =
+			"[\"say \\\"hi\\\"\\n\",-42,0.1,1e+21,255,{\"a\":[1.5,-0.25],\"b\":[]},[[1,true],[2,false]],[3,4],null,-9223372036854775808]";
+
+		std::string out;
+		SerDes<>::format_to(out, message);
+		bool pass = out == expected_text && SerDes<>::to_string(message) == expected_text;
+		out.clear();
+		SerDes<>::format_json(out, message);
+		pass = pass && out == expected_json;
+
+		// shortest round-trip floats
+		const double values[] = { 3.141592653589793, 1.0 / 3.0, 5e-324, 123456789012345680.0, -0.0 };
+		for (double value : values) {
+			out.clear();
+			SerDes<>::format_to(out, value);
+			pass = pass && strtod(out.c_str(), nullptr) == value && out.size() <= 24;
+		}
+		out.clear();
+		SerDes<>::format_to(out, 0.3f);
+		pass = pass && out == "0.3";
+
+		// the decimal point does not follow LC_NUMERIC (checked where a decimal comma locale is installed)
+		if (setlocale(LC_NUMERIC, "de_DE.UTF-8") || setlocale(LC_NUMERIC, "fr_FR.UTF-8")) {
+			pass = pass && SerDes<>::to_string(-0.25) == "-0.25" && SerDes<>::to_json(std::make_tuple(1.5f)) == "[1.5]";
+			setlocale(LC_NUMERIC, "C");
+		}
+
+		// former tuple_to_string, the elements without the braces
+		pass = pass && SerDes<>::tuple_to_string(std::make_tuple(7, std::string("x"), 0.5)) == "7, \"x\", 0.5";
+
+		// text is shortened after to_string_repeat_limit elements, JSON is complete
+		const std::vector<int> many(100, 7);
+		pass = pass && SerDes<>::to_string(many).size() == 1 + 64 * 3 + 3 + 1 && SerDes<>::to_json(many).size() == 1 + 100 * 2;
+
+		// steady state formatting keeps the buffer
+		out.clear();
+		SerDes<>::format_json(out, message);
+		const size_t capacity = out.capacity();
+		for (int i = 0; i < 100; i++) {
+			out.clear();
+			SerDes<>::format_json(out, message);
+		}
+		pass = pass && out == expected_json && out.capacity() == capacity;
+
+		printf("formatting[%zu] : %s\n\n", out.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// JSON text encoded straight to the wire format
+		typedef std::tuple<std::string, int16_t, uint64_t, double, float, bool, std::array<uint8_t, 3>,
+			std::vector<std::tuple<std::string, std::vector<int32_t>>>, std::map<std::string, double>,
+			std::map<uint32_t, std::string>, std::set<int8_t>> message_type;
+		message_type message("tab\tquote\" \xE2\x82\xAC", -300, UINT64_MAX, -1.25e-7, 3.5f, true, { { 1, 2, 255 } },
+			{ { "a", { 1, -2 } }, { "", {} } }, { { "x", 0.5 }, { "y", 1e300 } }, { { 7, "seven" } }, { -1, 5 });
+
+		std::vector<uint8_t> expected(SerDes<>::payload_size(message));
+		SerDes<>::serialize(expected.data(), message);
+
+		JsonEncoder<> encoder;
+		std::vector<uint8_t> wire;
+		bool pass = encoder.encode<message_type>(wire, SerDes<>::to_json(message)) && wire == expected;
+
+		// spaces and escapes, the output is appended
+		const std::string text = " [ \"tab\\tquote\\\" \\u20ac\" , -300, 18446744073709551615, -1.25e-7, 3.5, true, [1,2,255],\n"
+			"[[\"a\", [1, -2]], [\"\", []]], {\"x\": 0.5, \"y\": 1e300}, [[7, \"seven\"]], [-1, 5] ] ";
+		wire.assign(1, 0xAA);
+		pass = pass && encoder.encode<message_type>(wire, text) && wire.size() == expected.size() + 1 &&
+			std::equal(expected.begin(), expected.end(), wire.begin() + 1);
+		message_type decoded;
+		pass = pass && SerDes<>::deserialize(decoded, wire.data() + 1) == expected.size() && decoded == message;
+
+		// malformed or out of range input leaves the output unchanged
+		const char* rejected[] = { "[1, 2, 3", "[70000]", "[-1]", "[1.5]", "[1] x", "[\"\\q\"]" };
+		std::vector<uint8_t> unchanged(3, 1);
+		pass = pass && !encoder.encode<std::tuple<int32_t>>(unchanged, rejected[0], strlen(rejected[0]));
+		pass = pass && !encoder.encode<std::vector<int16_t>>(unchanged, rejected[1], strlen(rejected[1]));
+		pass = pass && !encoder.encode<std::vector<uint16_t>>(unchanged, rejected[2], strlen(rejected[2]));
+		pass = pass && !encoder.encode<std::vector<int>>(unchanged, rejected[3], strlen(rejected[3]));
+		pass = pass && !encoder.encode<std::vector<int>>(unchanged, rejected[4], strlen(rejected[4])) && encoder.error_position() == 4;
+		pass = pass && !encoder.encode<std::vector<std::string>>(unchanged, rejected[5], strlen(rejected[5]));
+		pass = pass && !encoder.encode<std::vector<float>>(unchanged, "[1e300]", 7) && !encoder.encode<std::vector<double>>(unchanged, "[+1]", 4);
+		pass = pass && unchanged == std::vector<uint8_t>(3, 1);
+
+		// numbers are parsed as the target type, with '.' whatever the C locale
+		std::vector<uint8_t> floats;
+		std::tuple<float, double> parsed;
+		pass = pass && encoder.encode<std::tuple<float, double>>(floats, "[0.1, 0.1]", 10) &&
+			SerDes<>::deserialize(parsed, floats.data()) == floats.size() && std::get<0>(parsed) == 0.1f && std::get<1>(parsed) == 0.1;
+
+		// std::vector<bool> round trips through its JSON array, a non bool element is rejected
+		typedef std::tuple<uint32_t, std::vector<bool>, std::vector<std::vector<bool>>> bits_type;
+		const bits_type bits(7, { true, false, true, true, false, false, false, false, true }, { {}, { false, true } });
+		std::vector<uint8_t> bits_wire, bits_expected(SerDes<>::payload_size(bits));
+		SerDes<>::serialize(bits_expected.data(), bits);
+		pass = pass && SerDes<>::to_json(bits) == "[7,[true,false,true,true,false,false,false,false,true],[[],[false,true]]]" &&
+			encoder.encode<bits_type>(bits_wire, SerDes<>::to_json(bits)) && bits_wire == bits_expected &&
+			!encoder.encode<std::vector<bool>>(unchanged, "[true, 1]", 9) && unchanged == std::vector<uint8_t>(3, 1);
+
+		printf("json encoding[%zu] : %s\n\n", expected.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Fixed size messages encoded at compile time offsets
+		constexpr auto control = SerDes<>::serialize_fixed(std::make_tuple(uint16_t(0x1234), int8_t(-1), std::array<uint32_t, 2>{ { 1, 0xAABBCCDD } }));
+		static_assert(control.size() == 11 && control[0] == 0x34 && control[1] == 0x12 && control[2] == 0xFF && control[10] == 0xAA, "");
+		constexpr auto control_big = SerDesBig::serialize_fixed(uint32_t(0x01020304));
+		static_assert(control_big[0] == 1 && control_big[3] == 4, "");
+
+		auto message = std::make_tuple(header_type(length_header_t(100U), (uint16_t)3, (uint16_t)4), 1.5, -2.25f, (int64_t)-7, true);
+		const auto little = SerDes<>::serialize_fixed(message);
+		const auto big = SerDesBig::serialize_fixed(message);
+		std::vector<uint8_t> little_ref(SerDes<>::payload_size(message)), big_ref(SerDesBig::payload_size(message));
+		SerDes<>::serialize(little_ref.data(), message);
+		SerDesBig::serialize(big_ref.data(), message);
+		bool pass = little.size() == little_ref.size() && std::equal(little.begin(), little.end(), little_ref.begin()) &&
+			big.size() == big_ref.size() && std::equal(big.begin(), big.end(), big_ref.begin());
+
+		printf("fixed size encoding[%zu] : %s\n\n", little.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Tagged messages read by older and newer schema versions
+		typedef std::tuple<uint32_t, std::string> v1_type;
+		typedef std::tuple<uint32_t, std::string, std::vector<double>, uint16_t, std::map<std::string, int>> v2_type;
+		const v1_type v1(7, "first");
+		const v2_type v2(8, "second", { 1.0, 2.0 }, 3, { { "k", 1 } });
+
+		std::vector<uint8_t> wire;
+		const size_t v1_size = SerDes<>::serialize_tagged(wire, v1);
+		const size_t v2_size = SerDes<>::serialize_tagged(wire, v2);
+		bool pass = v1_size + v2_size == wire.size();
+
+		// same schema
+		v1_type v1_dst;
+		v2_type v2_dst;
+		pass = pass && SerDes<>::deserialize_tagged(v1_dst, wire.data(), wire.size()) == v1_size && v1_dst == v1;
+		pass = pass && SerDes<>::deserialize_tagged(v2_dst, wire.data() + v1_size, v2_size) == v2_size && v2_dst == v2;
+		// old reader skips the new fields, new reader defaults them
+		pass = pass && SerDes<>::deserialize_tagged(v1_dst, wire.data() + v1_size, v2_size) == v2_size &&
+			v1_dst == v1_type(8, "second");
+		pass = pass && SerDes<>::deserialize_tagged(v2_dst, wire.data(), wire.size()) == v1_size &&
+			v2_dst == v2_type(7, "first", {}, 0, {});
+		// a field whose type changed is rejected
+		std::tuple<uint64_t, std::string> changed;
+		pass = pass && SerDes<>::deserialize_tagged(changed, wire.data(), wire.size()) == 0;
+		// a truncated message, or a field length past the message, is rejected
+		pass = pass && SerDes<>::deserialize_tagged(v2_dst, wire.data() + v1_size, v2_size - 1) == 0;
+		pass = pass && SerDes<>::deserialize_tagged(v2_dst, wire.data(), 3) == 0;
+		std::vector<uint8_t> corrupted(wire.begin() + v1_size, wire.end());
+		corrupted[corrupted.size() - SerDes<>::payload_size(std::get<4>(v2))] = 0x7F; // map count past its field
+		pass = pass && SerDes<>::deserialize_tagged(v2_dst, corrupted.data(), corrupted.size()) == 0;
+
+		printf("tagged messages[%zu, %zu] : %s\n\n", v1_size, v2_size, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Aligned layout read in place
+		typedef std::tuple<uint8_t, std::vector<double>, std::array<int32_t, 4>, std::string, uint64_t,
+			std::vector<std::array<float, 3>>, std::map<uint16_t, double>, std::deque<int16_t>> message_type;
+		message_type message(1, std::vector<double>(1000, 0.5), { { 1, 2, 3, 4 } }, "abc", 5,
+			{ { { 1.f, 2.f, 3.f } }, { { 4.f, 5.f, 6.f } } }, { { 1, 0.25 }, { 2, 0.75 } }, { -1, -2, -3 });
+		for (size_t i = 0; i < std::get<1>(message).size(); i++)
+			std::get<1>(message)[i] = (double)i / 3;
+
+		std::vector<uint8_t> wire(SerDes<>::aligned_payload_size(message));
+		bool pass = SerDes<>::serialize_aligned(wire.data(), message) == wire.size();
+		message_type decoded;
+		pass = pass && SerDes<>::deserialize_aligned(decoded, wire.data()) == wire.size() && decoded == message;
+
+		std::tuple<uint8_t, serdes::array_view<double>, serdes::block_view<std::array<int32_t, 4>>, std::string, uint64_t,
+			serdes::array_view<std::array<float, 3>>, std::map<uint16_t, double>, std::deque<int16_t>> view;
+		pass = pass && SerDes<>::deserialize_aligned(view, wire.data()) == wire.size();
+		const auto& values = std::get<1>(view);
+		pass = pass && values.size() == 1000 && std::equal(values.begin(), values.end(), std::get<1>(message).begin()) &&
+			(const uint8_t*)values.data() > wire.data() && (const uint8_t*)values.end() < wire.data() + wire.size() &&
+			*std::get<2>(view) == std::get<2>(message) && std::get<5>(view)[1] == std::get<5>(message)[1] &&
+			std::get<6>(view) == std::get<6>(message) && std::get<7>(view) == std::get<7>(message);
+
+		printf("aligned layout[%zu, packed %zu] : %s\n\n", wire.size(), SerDes<>::payload_size(message), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Checked decoding
+		typedef std::tuple<std::vector<std::string>, std::map<uint16_t, bool>, double> message_type;
+		message_type message{ { "alpha", "", "gamma" }, { { 1, true }, { 7, false } }, 2.5 };
+		std::vector<uint8_t> buf(SerDes<>::payload_size(message));
+		SerDes<>::serialize(buf.data(), message);
+
+		message_type decoded;
+		bool pass = SerDes<>::deserialize_checked(decoded, buf.data(), buf.size()) == buf.size() && decoded == message;
+		for (size_t size = 0; size < buf.size(); size++) // truncated
+			pass &= SerDes<>::validate<message_type>(buf.data(), size) == 0;
+
+		std::vector<uint8_t> forged(buf);
+		forged[0] = 0xFF; // string count far past the end
+		pass &= SerDes<>::deserialize_checked(decoded, forged.data(), forged.size()) == 0;
+		forged = buf;
+		forged[buf.size() - sizeof(double) - 1] = 2; // bool value
+		pass &= SerDes<>::validate<message_type>(forged.data(), forged.size()) == 0;
+
+		printf("checked decoding[%zu] : %s\n\n", buf.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Size hints
+		DynamicSerDes<> plain;
+		DynamicSerDes<> hinted;
+		hinted.set_size_hints(true);
+
+		bool pass = true;
+		size_t fallbacks = 0;
+		std::vector<uint8_t> expected, frame;
+		for (size_t i = 0; i < 64; i++) {
+			// sizes wander, with a jump every 16 messages
+			std::vector<std::string> names(i % 16 == 15 ? 400 : 10 + i % 5, std::string(i % 7, 'n'));
+			std::map<uint16_t, float> values{ { (uint16_t)i, 1.5f } };
+			const size_t hint = hinted.size_hint(7, 3);
+			plain.build_command<7, 3>(expected, names, values, (uint32_t)i);
+			const size_t size = hinted.build_command<7, 3>(frame, names, values, (uint32_t)i);
+			fallbacks += size - sizeof(header_type) > hint + hint / 8;
+			pass &= frame == expected;
+
+			std::tuple<std::vector<std::string>, std::map<uint16_t, float>, uint32_t> args;
+			pass &= hinted.parse_command(frame.data(), args) == size && std::get<0>(args) == names && std::get<2>(args) == i;
+		}
+		pass &= hinted.size_hint(7, 3) != 0 && hinted.size_hint(7, 4) == 0 && fallbacks < 16;
+
+		printf("size hints[%zu, fallbacks %zu] : %s\n\n", hinted.size_hint(7, 3), fallbacks, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Bit packing
+		enum class mode : uint8_t { idle, run, stop, fault };
+		typedef std::tuple<bool, bool, serdes::bits<2, mode>, serdes::bits<5, int8_t>, uint32_t,
+			std::bitset<12>, std::tuple<bool, std::bitset<70>>> status_type;
+		std::bitset<70> wide;
+		wide.set(0).set(33).set(69);
+		status_type status(true, false, mode::fault, (int8_t)-7, 0xDEADBEEF, std::bitset<12>(0xABC), std::make_tuple(true, wide));
+
+		// bools, mode and int8_t in 2 bytes, uint32_t, bitset<12> in 2 bytes, nested bool + bitset<70> in 9 bytes
+		std::vector<uint8_t> packed(SerDes<>::packed_payload_size(status));
+		bool pass = packed.size() == 2 + 4 + 2 + 9 && SerDes<>::serialize_packed(packed.data(), status) == packed.size();
+		pass &= packed[0] == 0x9D && packed[1] == 0x01; // 1, 0, 11, 11001 from the low bits
+		status_type decoded;
+		pass &= SerDes<>::deserialize_packed(decoded, packed.data()) == packed.size() && decoded == status;
+		pass &= std::get<3>(decoded) == -7;
+
+		std::vector<bool> flags(1001);
+		for (size_t i = 0; i < flags.size(); i++)
+			flags[i] = i % 3 == 0;
+		std::vector<uint8_t> buf(SerDes<>::payload_size(flags));
+		pass &= buf.size() == sizeof(uint32_t) + 126 && SerDes<>::serialize(buf.data(), flags) == buf.size();
+		std::vector<bool> flags_dst;
+		pass &= SerDes<>::deserialize_checked(flags_dst, buf.data(), buf.size()) == buf.size() && flags_dst == flags;
+		pass &= SerDes<>::to_string(std::vector<bool>{ true, false }) == "{1, 0}";
+
+		printf("bit packing[%zu, vector<bool> %zu] : %s\n\n", packed.size(), buf.size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Coalescing writer
+		std::vector<uint8_t> stream;
+		size_t writes = 0;
+		CoalescingWriter<> writer([&](const uint8_t* data, size_t size) {
+			stream.insert(stream.end(), data, data + size);
+			writes++;
+			return true;
+		}, 256, std::chrono::milliseconds(5));
+
+		for (uint32_t i = 0; i < 100; i++)
+			writer.send<3, 1>(i, std::string("tick"));
+		bool pass = writes > 0 && writes < 10 && !writer.empty();
+		// the rest leaves on the deadline
+		pass &= writer.poll(writer.deadline() - std::chrono::milliseconds(1)) && !writer.empty();
+		pass &= writer.poll(writer.deadline()) && writer.empty();
+		const size_t coalesced_writes = writes;
+
+		writer.send<3, 2>((uint32_t)100, std::string("queued"));
+		writer.send_now<3, 3>((uint32_t)101, std::string("urgent")); // after the queued one
+		writer.set_mode(CoalescingWriter<>::mode::bypass);
+		writer.send<3, 4>((uint32_t)102, std::string("bypass"));
+		pass &= writes == coalesced_writes + 2 && writer.empty();
+
+		// every frame arrives once, in order
+		uint32_t expected = 0;
+		for (size_t pos = 0; pos < stream.size();) {
+			const size_t size = DynamicSerDes<>::frame_size(stream.data() + pos, stream.size() - pos);
+			std::tuple<uint32_t, std::string> args;
+			DynamicSerDes<> dyn_serdes;
+			pass &= size != 0 && dyn_serdes.parse_command(stream.data() + pos, args) == size && std::get<0>(args) == expected++;
+			pos += size == 0 ? stream.size() : size;
+		}
+		pass &= expected == 103;
+
+		printf("coalescing writer[%zu frames, %zu writes] : %s\n\n", (size_t)expected, writes, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Codec library (extern templates, instantiated in src/messages/messages.cpp)
+		messages::order src(42, "ACME", -100, 12.5, { { "tif", "ioc" }, { "venue", "X" } });
+		std::vector<uint8_t> buf;
+		const size_t size = MessageCodec<messages::order>::append(buf, src);
+		bool pass = size == buf.size() && size == MessageCodec<messages::order>::payload_size(src);
+		pass &= size == SerDes<>::payload_size(src); // same encoding as SerDes
+
+		messages::order dst;
+		pass &= MessageCodec<messages::order>::deserialize_checked(dst, buf.data(), buf.size()) == size && dst == src;
+		pass &= MessageCodec<messages::order>::deserialize_checked(dst, buf.data(), buf.size() - 1) == 0;
+
+		printf("codec library[%zu] : %s\n\n", size, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+#ifdef __unix__
+	{
+		// Memory mapped snapshot with lazy access
+		typedef std::tuple<uint64_t, std::vector<std::string>, std::vector<bytePackStruct>, COMPLEX_O9> snapshot_type;
+
+		snapshot_type serial_src, deserial_dst;
+		std::get<0>(serial_src) = 42;
+		for (int i = 0; i < 1000; i++) {
+			std::get<1>(serial_src).push_back("name" + std::to_string(i));
+			std::get<2>(serial_src).push_back(bytePackStruct{ (char)i, (unsigned char)i, (short)i, (float)i, i, (double)i });
+		}
+		std::get<3>(serial_src).resize(2);
+		std::get<1>(std::get<3>(serial_src)[1]) = "lazy COMPLEX_O9";
+
+		const char* path = "serdes_snapshot_test.bin";
+		SnapshotFile<> snapshot;
+		bool pass = SnapshotFile<>::save(path, serial_src) && snapshot.open<snapshot_type>(path);
+
+		auto view = snapshot.view<snapshot_type>();
+		std::string name;
+		view.get<1>()[777].decode(name);
+		bytePackStruct elem = view.get<2>()[500].get();
+		std::string complex_name;
+		view.get<3>()[1].get<1>().decode(complex_name);
+
+		pass = pass && view.get<0>().get() == 42 && view.get<1>().size() == 1000 && name == "name777" &&
+			elem.s32 == 500 && complex_name == "lazy COMPLEX_O9" &&
+			view.encoded_size() == snapshot.payload_size() &&
+			snapshot.load(deserial_dst);
+
+		// compare of the reloaded object (struct padding is not preserved, so no byte compare)
+		pass = pass && std::get<1>(deserial_dst) == std::get<1>(serial_src) &&
+			memcmp(std::get<2>(deserial_dst).data(), std::get<2>(serial_src).data(), sizeof(bytePackStruct) * 1000) == 0 &&
+			std::get<1>(std::get<3>(deserial_dst)[1]) == "lazy COMPLEX_O9";
+
+		// a corrupted element count is rejected by open(), before any view reads past the file
+		std::vector<std::array<uint16_t, 3>> arrays(10);
+		SnapshotFile<> corrupted;
+		pass = pass && SnapshotFile<>::save(path, arrays) && corrupted.open<decltype(arrays)>(path) &&
+			corrupted.view<decltype(arrays)>()[9].size() == 3;
+		if (FILE* fp = fopen(path, "r+b")) {
+			const uint32_t count = 1000;
+			fseek(fp, (long)SnapshotFile<>::file_header_size, SEEK_SET);
+			fwrite(&count, sizeof(count), 1, fp);
+			fclose(fp);
+		}
+		pass = pass && !corrupted.open<decltype(arrays)>(path) && !corrupted.open<snapshot_type>(path);
+		remove(path);
+
+		printf("snapshot[%u] : %s\n\n", (uint32_t)snapshot.payload_size(), pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Append-only record log with a sparse offset index
+		const char* path = "serdes_record_log_test.log";
+		remove(path);
+		remove(serdes::log_index_path(path).c_str());
+
+		// an index interval of 0 is rejected
+		RecordLogWriter<> writer(4096);
+		RecordLogReader<> no_index;
+		bool pass = !writer.open(path, 0) && !no_index.open(path, 0) && writer.open(path, 16);
+		for (uint32_t i = 0; i < 1000; i++)
+			writer.append<7, 1>(i, std::string("event") + std::to_string(i));
+		pass = pass && writer.commit();
+		writer.close();
+
+		// reopen, append and leave a torn frame behind
+		pass = pass && writer.open(path, 16) && writer.size() == 1000;
+		for (uint32_t i = 1000; i < 1010; i++)
+			writer.append<7, 1>(i, std::string("event") + std::to_string(i));
+		writer.close();
+		FILE* torn = fopen(path, "ab");
+		fwrite("\x40\x00\x00\x40garbage", 1, 11, torn);
+		fclose(torn);
+
+		RecordLogReader<> reader;
+		DynamicSerDes<> dyn_serdes;
+		pass = pass && reader.open(path, 16) && reader.size() == 1010;
+
+		std::tuple<uint32_t, std::string> event;
+		uint32_t replayed = 0;
+		for (auto& rec : reader) {
+			pass = pass && dyn_serdes.parse_command(rec.frame, event) == rec.size && std::get<0>(event) == replayed;
+			replayed++;
+		}
+		auto it = reader.seek(523);
+		pass = pass && replayed == 1010 && it != reader.end() &&
+			dyn_serdes.parse_command(it->frame, event) && std::get<1>(event) == "event523" &&
+			reader.seek(1010) == reader.end();
+
+		// a write failing part way (file size limit) is truncated back and written again by commit()
+		remove(path);
+		remove(serdes::log_index_path(path).c_str());
+		RecordLogWriter<> limited(4096);
+		pass = pass && limited.open(path, 16);
+		for (uint32_t i = 0; i < 200; i++)
+			pass = pass && limited.append<7, 1>(i, std::string("event") + std::to_string(i)) != 0;
+		pass = pass && limited.commit();
+		struct stat committed;
+		struct rlimit saved_limit, file_limit;
+		pass = pass && stat(path, &committed) == 0 && getrlimit(RLIMIT_FSIZE, &saved_limit) == 0;
+		file_limit = saved_limit;
+		file_limit.rlim_cur = (rlim_t)committed.st_size + 100;
+		signal(SIGXFSZ, SIG_IGN);
+		setrlimit(RLIMIT_FSIZE, &file_limit);
+		// the records stay batched, all of them are in the log once the limit is lifted
+		uint32_t appended = 200;
+		bool append_failed = false;
+		for (; appended < 1000 && !append_failed; appended++)
+			append_failed = limited.append<7, 1>(appended, std::string("event") + std::to_string(appended)) == 0;
+		pass = pass && append_failed && !limited.commit() && !limited.is_failed();
+		setrlimit(RLIMIT_FSIZE, &saved_limit);
+		signal(SIGXFSZ, SIG_DFL);
+		pass = pass && limited.commit();
+		limited.close();
+		RecordLogReader<> limited_reader;
+		pass = pass && limited_reader.open(path, 16) && limited_reader.size() == appended;
+		uint32_t limited_replayed = 0;
+		for (auto& rec : limited_reader)
+			pass = pass && dyn_serdes.parse_command(rec.frame, rec.size, event) == rec.size && std::get<0>(event) == limited_replayed++;
+		auto limited_it = limited_reader.seek(appended - 1);
+		pass = pass && limited_replayed == appended && limited_it != limited_reader.end() &&
+			dyn_serdes.parse_command(limited_it->frame, limited_it->size, event) && std::get<0>(event) == appended - 1;
+
+		remove(path);
+		remove(serdes::log_index_path(path).c_str());
+
+		printf("record log[%u] : %s\n\n", replayed, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Shared memory channel between processes
+		typedef std::tuple<uint32_t, std::vector<float>> sample_type;
+		constexpr uint32_t messages = 10000;
+		const std::string name = "/serdes_shm_test_" + std::to_string(getpid());
+
+		SharedMemoryChannel<> consumer;
+		bool pass = consumer.create(name.c_str(), 1 << 16);
+
+		pid_t child = pass ? fork() : -1;
+		pass = pass && child >= 0;
+		if (child == 0) {
+			SharedMemoryChannel<> producer;
+			if (!producer.open(name.c_str()))
+				_exit(EXIT_FAILURE);
+			for (uint32_t i = 0; i < messages; i++)
+				while (producer.try_send_command<2, 9>(i, std::vector<float>(i % 16, (float)i)) == serdes::push_result::full)
+					std::this_thread::yield();
+			_exit(EXIT_SUCCESS);
+		}
+
+		DynamicSerDes<> dyn_serdes;
+		sample_type sample;
+		uint32_t received = 0;
+		while (pass && received < messages && consumer.wait(5000)) {
+			size_t size;
+			const uint8_t* frame = consumer.ring().front(size);
+			pass = dyn_serdes.parse_command(frame, sample) == size &&
+				std::get<0>(sample) == received && std::get<1>(sample).size() == received % 16;
+			consumer.ring().pop();
+			received++;
+		}
+
+		int status = 0;
+		if (child > 0) {
+			if (!pass || received < messages) // the producer may be blocked on a full ring
+				kill(child, SIGKILL);
+			waitpid(child, &status, 0);
+		}
+		SharedMemoryChannel<>::unlink(name.c_str());
+		pass = pass && received == messages && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+
+		printf("shared memory channel[%u] : %s\n\n", received, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//----------------------------------------------------------------------------------------------------
+	{
+		// Sliced asynchronous sends over a socketpair, drained from the same loop
+		int fds[2];
+		bool pass = ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0 && serdes::set_nonblocking(fds[1]);
+
+		constexpr size_t slice_bytes = 4096;
+		AsyncCommandWriter<> writer(fds[0], slice_bytes, 4);
+		std::vector<uint32_t> big(1 << 18);
+		for (size_t i = 0; i < big.size(); i++)
+			big[i] = (uint32_t)(i * 2654435761U);
+		std::vector<std::string> names(3000, "element name");
+		const std::vector<uint32_t> big_copy = big;
+
+		int completed = 0;
+		pass = pass && writer.send<3, 1>([&](bool ok) { completed += ok; }, std::move(big), std::string("tail"));
+		pass = pass && writer.send<3, 2>([&](bool ok) { completed += ok; }, names);
+		pass = pass && writer.send<3, 3>([&](bool ok) { completed += ok; }, (uint16_t)7);
+
+		std::vector<uint8_t> stream;
+		size_t max_buffered = 0;
+		uint8_t chunk[1024]; // a slow reader, the writer has to stop encoding
+		while (pass && (writer.wants_write() || completed < 3)) {
+			pass = writer.poll();
+			max_buffered = std::max(max_buffered, writer.buffered());
+			const ssize_t n = ::read(fds[1], chunk, sizeof(chunk));
+			if (n > 0)
+				stream.insert(stream.end(), chunk, chunk + n);
+		}
+		for (ssize_t n; (n = ::read(fds[1], chunk, sizeof(chunk))) > 0;)
+			stream.insert(stream.end(), chunk, chunk + n);
+
+		DynamicSerDes<> dyn_serdes;
+		std::tuple<std::vector<uint32_t>, std::string> first;
+		std::tuple<std::vector<std::string>> second;
+		std::tuple<uint16_t> third;
+		size_t cursor = 0, frame = 0;
+		pass = pass && (frame = dyn_serdes.parse_command(stream.data(), first)) != 0;
+		pass = pass && (cursor += frame, frame = dyn_serdes.parse_command(stream.data() + cursor, second)) != 0;
+		pass = pass && (cursor += frame, frame = dyn_serdes.parse_command(stream.data() + cursor, third)) != 0;
+		pass = pass && cursor + frame == stream.size() && completed == 3 &&
+			std::get<0>(first) == big_copy && std::get<1>(first) == "tail" &&
+			std::get<0>(second) == names && std::get<0>(third) == 7 &&
+			max_buffered < 2 * slice_bytes;
+		::close(fds[0]);
+		::close(fds[1]);
+
+		// the payload size of a large container of strings is measured over several slices too
+		std::vector<std::string> many_names(200000, "element name");
+		std::vector<uint8_t> sliced, expected_frame;
+		dyn_serdes.build_command<3, 5>(expected_frame, many_names);
+		SlicedCommandEncoder<3, 5, std::tuple<std::vector<std::string>>> sliced_encoder(std::make_tuple(many_names));
+		size_t slices = 0, max_slice = 0, empty_slices = 0;
+		for (bool done = false; !done; slices++) {
+			const size_t before = sliced.size();
+			done = sliced_encoder(sliced, slice_bytes);
+			max_slice = std::max(max_slice, sliced.size() - before);
+			empty_slices += sliced.size() == before;
+		}
+		pass = pass && sliced == expected_frame && empty_slices >= SerDes<>::payload_size(many_names) / (slice_bytes + 64) &&
+			max_slice < slice_bytes + 64;
+
+		// a closed peer fails the sends with EPIPE instead of raising SIGPIPE
+		bool closed_ok = true;
+		pass = pass && ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0;
+		::close(fds[1]);
+		AsyncCommandWriter<> orphan(fds[0]);
+		pass = pass && orphan.send<3, 4>([&](bool ok) { closed_ok = ok; }, std::string("lost")) &&
+			!orphan.poll() && !closed_ok && orphan.error() == EPIPE;
+		::close(fds[0]);
+
+		// a writer destroyed with queued frames completes them with false, waiting coroutines resume
+		int dropped_completions = 0;
+#ifdef SERDES_ASYNC_COROUTINE
+		int awaited = -1;
+#endif
+		pass = pass && ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0;
+		{
+			AsyncCommandWriter<> dropped(fds[0]);
+			pass = pass && dropped.send<3, 5>([&](bool ok) { dropped_completions += ok ? 100 : 1; }, std::string("queued"));
+#ifdef SERDES_ASYNC_COROUTINE
+			await_send(dropped, awaited);
+			pass = pass && awaited == -1;
+#endif
+		}
+		pass = pass && dropped_completions == 1;
+#ifdef SERDES_ASYNC_COROUTINE
+		pass = pass && awaited == 0;
+#endif
+		::close(fds[0]);
+		::close(fds[1]);
+
+		printf("async writer[%zu], max buffered[%zu] : %s\n\n", stream.size(), max_buffered, pass ? "pass" : "fail");
+		ret |= pass ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+#endif
     
     return ret;
 }
\ No newline at end of file